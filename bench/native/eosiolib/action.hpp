@@ -0,0 +1,55 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib inline actions. An inline action is queued on the running
+ *  action and later executed against a freshly constructed contract, as nodeos would.
+ */
+#pragma once
+
+#include <eosiolib/datastream.hpp>
+#include <eosiolib/native.hpp>
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace eosio {
+
+   template<name::raw Name, auto Action>
+   struct action_wrapper {
+      static constexpr eosio::name action_name = eosio::name(Name);
+   };
+
+   namespace native {
+
+      // executes Action of contract C on receiver right away, used by benchmarks to push transactions
+      template<typename C, typename... Args>
+      void push_action( name receiver, name act, void (C::*m)(Args...), const std::vector<permission_level>& auths,
+                        std::decay_t<Args>... args ) {
+         auto params = std::make_tuple( std::move(args)... );
+         execute( act, auths, [&]() {
+            C c( receiver, receiver, datastream<const char*>( nullptr, 0 ) );
+            std::apply( [&]( auto&... a ) { (c.*m)( a... ); }, params );
+         });
+      }
+
+      template<typename C, typename... Args>
+      void send_inline( const C& sender, void (C::*m)(Args...), name act, std::vector<permission_level> auths,
+                        std::tuple<std::decay_t<Args>...> params ) {
+         auto& c = state();
+         check( c.inlines != nullptr, "inline action sent outside of an action" );
+         const name receiver = sender.get_self();
+         c.inlines->emplace_back( [=]() {
+            execute( act, auths, [&]() {
+               C inst( receiver, receiver, datastream<const char*>( nullptr, 0 ) );
+               auto args = params;
+               std::apply( [&]( auto&... a ) { (inst.*m)( a... ); }, args );
+            });
+         });
+      }
+
+   } /// namespace native
+
+} /// namespace eosio
+
+#define SEND_INLINE_ACTION( CONTRACT, NAME, ... ) \
+   ::eosio::native::send_inline( CONTRACT, &std::decay_t<decltype(CONTRACT)>::NAME, ::eosio::name(#NAME), __VA_ARGS__ )
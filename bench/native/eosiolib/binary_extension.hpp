@@ -0,0 +1,42 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib binary_extension for host benchmarks.
+ */
+#pragma once
+
+#include <eosiolib/system.hpp>
+
+#include <optional>
+
+namespace eosio {
+
+   template <typename T>
+   class binary_extension {
+      public:
+         constexpr binary_extension() {}
+         constexpr binary_extension( const T& ext ) : _ext(ext) {}
+
+         constexpr bool has_value() const { return _ext.has_value(); }
+
+         T& value() {
+            check( _ext.has_value(), "cannot get value of empty binary_extension" );
+            return *_ext;
+         }
+
+         const T& value() const {
+            check( _ext.has_value(), "cannot get value of empty binary_extension" );
+            return *_ext;
+         }
+
+         template <typename... Args>
+         T& emplace( Args&&... args ) {
+            return _ext.emplace( std::forward<Args>(args)... );
+         }
+
+         void reset() { _ext.reset(); }
+
+      private:
+         std::optional<T> _ext;
+   };
+
+} /// namespace eosio
@@ -0,0 +1,25 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib contract base class.
+ */
+#pragma once
+
+#include <eosiolib/datastream.hpp>
+#include <eosiolib/name.hpp>
+
+namespace eosio {
+
+   class contract {
+      public:
+         contract( name receiver, name code, datastream<const char*> ds ) : _self(receiver), _code(code), _ds(ds) {}
+
+         inline name get_self() const { return _self; }
+         inline name get_code() const { return _code; }
+
+      protected:
+         name                     _self;
+         name                     _code;
+         datastream<const char*>  _ds;
+   };
+
+} /// namespace eosio
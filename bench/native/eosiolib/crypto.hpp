@@ -0,0 +1,99 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib checksum256 and sha256 for host benchmarks.
+ */
+#pragma once
+
+#include <eosiolib/public_key.hpp>
+#include <eosiolib/signature.hpp>
+#include <eosiolib/system.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace eosio {
+
+   class checksum256 {
+      public:
+         checksum256() { _bytes.fill( 0 ); }
+         explicit checksum256( const std::array<uint8_t, 32>& bytes ) : _bytes(bytes) {}
+
+         std::array<uint8_t, 32> extract_as_byte_array() const { return _bytes; }
+
+         friend bool operator == ( const checksum256& a, const checksum256& b ) { return a._bytes == b._bytes; }
+         friend bool operator != ( const checksum256& a, const checksum256& b ) { return a._bytes != b._bytes; }
+         friend bool operator < ( const checksum256& a, const checksum256& b ) { return a._bytes < b._bytes; }
+
+      private:
+         std::array<uint8_t, 32> _bytes;
+   };
+
+   // FIPS 180-4 sha256, the chain computes it in the sha256 intrinsic
+   inline checksum256 sha256( const char* data, uint32_t length ) {
+      static constexpr uint32_t k[64] = {
+         0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+         0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+         0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+         0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+         0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+         0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+         0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+         0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+      };
+      auto rotr = []( uint32_t x, int n ) { return ( x >> n ) | ( x << ( 32 - n ) ); };
+
+      uint32_t h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+      // message, 0x80, zero padding and the bit length, in whole 64 byte blocks
+      const uint64_t padded = ( ( uint64_t(length) + 8 ) / 64 + 1 ) * 64;
+      for ( uint64_t off = 0; off < padded; off += 64 ) {
+         uint8_t block[64];
+         for ( uint64_t i = 0; i < 64; ++i ) {
+            const uint64_t pos = off + i;
+            if ( pos < length ) {
+               block[i] = uint8_t( data[pos] );
+            } else if ( pos == length ) {
+               block[i] = 0x80;
+            } else if ( pos >= padded - 8 ) {
+               block[i] = uint8_t( ( uint64_t(length) * 8 ) >> ( 8 * ( padded - 1 - pos ) ) );
+            } else {
+               block[i] = 0;
+            }
+         }
+
+         uint32_t w[64];
+         for ( int i = 0; i < 16; ++i ) {
+            w[i] = uint32_t(block[4*i]) << 24 | uint32_t(block[4*i+1]) << 16 | uint32_t(block[4*i+2]) << 8 | block[4*i+3];
+         }
+         for ( int i = 16; i < 64; ++i ) {
+            const uint32_t s0 = rotr( w[i-15], 7 ) ^ rotr( w[i-15], 18 ) ^ ( w[i-15] >> 3 );
+            const uint32_t s1 = rotr( w[i-2], 17 ) ^ rotr( w[i-2], 19 ) ^ ( w[i-2] >> 10 );
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+         }
+
+         uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+         for ( int i = 0; i < 64; ++i ) {
+            const uint32_t t1 = hh + ( rotr( e, 6 ) ^ rotr( e, 11 ) ^ rotr( e, 25 ) ) + ( ( e & f ) ^ ( ~e & g ) ) + k[i] + w[i];
+            const uint32_t t2 = ( rotr( a, 2 ) ^ rotr( a, 13 ) ^ rotr( a, 22 ) ) + ( ( a & b ) ^ ( a & c ) ^ ( b & c ) );
+            hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+         }
+         h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+      }
+
+      std::array<uint8_t, 32> out;
+      for ( int i = 0; i < 8; ++i ) {
+         out[4*i]   = uint8_t( h[i] >> 24 );
+         out[4*i+1] = uint8_t( h[i] >> 16 );
+         out[4*i+2] = uint8_t( h[i] >> 8 );
+         out[4*i+3] = uint8_t( h[i] );
+      }
+      return checksum256( out );
+   }
+
+   // key recovery is not emulated, benchmarks do not submit signed states
+   inline void assert_recover_key( const checksum256&, const signature&, const public_key& ) {
+      check( false, "assert_recover_key is not available natively" );
+   }
+
+} /// namespace eosio
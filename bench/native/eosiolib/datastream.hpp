@@ -0,0 +1,21 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib datastream, contracts only carry it through their constructor.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace eosio {
+
+   template<typename T>
+   class datastream {
+      public:
+         datastream( T start, size_t s ) : _start(start), _size(s) {}
+
+      private:
+         T       _start;
+         size_t  _size;
+   };
+
+} /// namespace eosio
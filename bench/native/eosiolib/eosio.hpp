@@ -0,0 +1,17 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib/eosio.hpp. Dispatch is replaced by native::push_action, so
+ *  EOSIO_DISPATCH expands to nothing.
+ */
+#pragma once
+
+#include <eosiolib/action.hpp>
+#include <eosiolib/asset.hpp>
+#include <eosiolib/contract.hpp>
+#include <eosiolib/multi_index.hpp>
+#include <eosiolib/name.hpp>
+#include <eosiolib/native.hpp>
+#include <eosiolib/symbol.hpp>
+#include <eosiolib/system.hpp>
+
+#define EOSIO_DISPATCH( TYPE, MEMBERS )
@@ -0,0 +1,274 @@
+/**
+ *  @file
+ *  In-memory stand-in of eosiolib multi_index for host benchmarks.
+ *
+ *  Rows of every (code, scope, table) live in one shared store, secondary indexes are kept
+ *  as ordered sets of (key, primary key). Every operation bumps the counter of the intrinsic
+ *  the real multi_index would have called, so benchmarks can report db traffic per action.
+ */
+#pragma once
+
+#include <eosiolib/name.hpp>
+#include <eosiolib/native.hpp>
+#include <eosiolib/system.hpp>
+
+#include <iterator>
+#include <map>
+#include <set>
+#include <tuple>
+#include <type_traits>
+
+namespace eosio {
+
+   template<name::raw IndexName, typename Extractor>
+   struct indexed_by {
+      static constexpr uint64_t index_name = static_cast<uint64_t>(IndexName);
+      typedef Extractor secondary_extractor_type;
+   };
+
+   template<class Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+   struct const_mem_fun {
+      typedef std::remove_cv_t<std::remove_reference_t<Type>> result_type;
+
+      result_type operator()( const Class& x ) const { return (x.*PtrToMemberFunction)(); }
+   };
+
+   namespace native {
+
+      template<typename T, typename... Indices>
+      struct table_store {
+         std::map<uint64_t, T> rows;
+         std::tuple< std::set< std::pair< typename Indices::secondary_extractor_type::result_type, uint64_t > >... > indices;
+      };
+
+      inline void count_read( uint64_t n = 1 )  { state().stats.db_reads += n; }
+      inline void count_write( uint64_t n = 1 ) { state().stats.db_writes += n; }
+
+   } /// namespace native
+
+   template<name::raw TableName, typename T, typename... Indices>
+   class multi_index {
+      private:
+         typedef native::table_store<T, Indices...> store_type;
+         typedef typename std::map<uint64_t, T>::const_iterator row_iterator;
+
+         template<size_t I>
+         using index_set = std::tuple_element_t<I, decltype(store_type::indices)>;
+
+         template<size_t I>
+         using index_key = typename std::tuple_element_t<I, std::tuple<Indices...>>::secondary_extractor_type::result_type;
+
+         template<size_t I>
+         static index_key<I> extract( const T& obj ) {
+            return typename std::tuple_element_t<I, std::tuple<Indices...>>::secondary_extractor_type{}( obj );
+         }
+
+         template<uint64_t IndexName>
+         static constexpr size_t index_position() {
+            constexpr uint64_t names[] = { Indices::index_name..., 0 };
+            for( size_t i = 0; i < sizeof...(Indices); ++i ) {
+               if( names[i] == IndexName ) {
+                  return i;
+               }
+            }
+            return sizeof...(Indices);
+         }
+
+         template<size_t... I>
+         void insert_keys( const T& obj, std::index_sequence<I...> ) {
+            ( std::get<I>( _store->indices ).emplace( extract<I>( obj ), obj.primary_key() ), ... );
+         }
+
+         template<size_t... I>
+         void erase_keys( const T& obj, std::index_sequence<I...> ) {
+            ( std::get<I>( _store->indices ).erase( std::make_pair( extract<I>( obj ), obj.primary_key() ) ), ... );
+         }
+
+         template<size_t... I>
+         void update_keys( const std::tuple<index_key<I>...>& old_keys, const T& obj, std::index_sequence<I...> ) {
+            ( update_key<I>( std::get<I>( old_keys ), obj ), ... );
+         }
+
+         template<size_t I>
+         void update_key( const index_key<I>& old_key, const T& obj ) {
+            auto new_key = extract<I>( obj );
+            if( new_key == old_key ) {
+               return;
+            }
+            auto& idx = std::get<I>( _store->indices );
+            idx.erase( std::make_pair( old_key, obj.primary_key() ) );
+            idx.emplace( new_key, obj.primary_key() );
+            native::count_write();
+         }
+
+         template<size_t... I>
+         std::tuple<index_key<I>...> keys_of( const T& obj, std::index_sequence<I...> ) const {
+            return std::make_tuple( extract<I>( obj )... );
+         }
+
+         name                         _code;
+         uint64_t                     _scope;
+         std::shared_ptr<store_type>  _store;
+
+      public:
+         struct const_iterator {
+            typedef std::bidirectional_iterator_tag  iterator_category;
+            typedef T                                value_type;
+            typedef std::ptrdiff_t                   difference_type;
+            typedef const T*                         pointer;
+            typedef const T&                         reference;
+
+            const_iterator() {}
+            explicit const_iterator( row_iterator it ) : _it(it) {}
+
+            const T& operator*() const { return _it->second; }
+            const T* operator->() const { return &_it->second; }
+
+            const_iterator& operator++() { native::count_read(); ++_it; return *this; }
+            const_iterator& operator--() { native::count_read(); --_it; return *this; }
+            const_iterator operator++(int) { auto r = *this; ++*this; return r; }
+            const_iterator operator--(int) { auto r = *this; --*this; return r; }
+
+            friend bool operator == ( const const_iterator& a, const const_iterator& b ) { return a._it == b._it; }
+            friend bool operator != ( const const_iterator& a, const const_iterator& b ) { return a._it != b._it; }
+
+            row_iterator _it;
+         };
+
+         template<size_t I>
+         class index {
+            public:
+               typedef index_key<I> secondary_key_type;
+               typedef typename index_set<I>::const_iterator key_iterator;
+
+               struct const_iterator {
+                  typedef std::bidirectional_iterator_tag  iterator_category;
+                  typedef T                                value_type;
+                  typedef std::ptrdiff_t                   difference_type;
+                  typedef const T*                         pointer;
+                  typedef const T&                         reference;
+
+                  const_iterator() {}
+                  const_iterator( const store_type* store, key_iterator it ) : _store(store), _it(it) {}
+
+                  const T& operator*() const { return _store->rows.at( _it->second ); }
+                  const T* operator->() const { return &**this; }
+
+                  const_iterator& operator++() { native::count_read(); ++_it; return *this; }
+                  const_iterator& operator--() { native::count_read(); --_it; return *this; }
+                  const_iterator operator++(int) { auto r = *this; ++*this; return r; }
+                  const_iterator operator--(int) { auto r = *this; --*this; return r; }
+
+                  friend bool operator == ( const const_iterator& a, const const_iterator& b ) { return a._it == b._it; }
+                  friend bool operator != ( const const_iterator& a, const const_iterator& b ) { return a._it != b._it; }
+
+                  const store_type*  _store = nullptr;
+                  key_iterator       _it;
+               };
+               typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+               explicit index( const store_type* store ) : _store(store) {}
+
+               const_iterator begin() const { native::count_read(); return const_iterator( _store, keys().begin() ); }
+               const_iterator end() const { return const_iterator( _store, keys().end() ); }
+               const_reverse_iterator rbegin() const { native::count_read(); return const_reverse_iterator( end() ); }
+               const_reverse_iterator rend() const { return const_reverse_iterator( const_iterator( _store, keys().begin() ) ); }
+
+               const_iterator lower_bound( const secondary_key_type& key ) const {
+                  native::count_read();
+                  return const_iterator( _store, keys().lower_bound( std::make_pair( key, uint64_t(0) ) ) );
+               }
+
+               const_iterator find( const secondary_key_type& key ) const {
+                  auto it = lower_bound( key );
+                  if( it._it == keys().end() || it._it->first != key ) {
+                     return end();
+                  }
+                  return it;
+               }
+
+            private:
+               const index_set<I>& keys() const { return std::get<I>( _store->indices ); }
+
+               const store_type* _store;
+         };
+
+         multi_index( name code, uint64_t scope )
+         :_code(code), _scope(scope),
+          _store( native::table<store_type>( code.value, scope, static_cast<uint64_t>(TableName) ) ) {}
+
+         name get_code() const { return _code; }
+         uint64_t get_scope() const { return _scope; }
+
+         const_iterator begin() const { native::count_read(); return const_iterator( _store->rows.begin() ); }
+         const_iterator end() const { return const_iterator( _store->rows.end() ); }
+
+         const_iterator find( uint64_t primary ) const {
+            native::count_read();
+            return const_iterator( _store->rows.find( primary ) );
+         }
+
+         const_iterator lower_bound( uint64_t primary ) const {
+            native::count_read();
+            return const_iterator( _store->rows.lower_bound( primary ) );
+         }
+
+         const T& get( uint64_t primary, const char* error_msg = "unable to find key" ) const {
+            auto it = find( primary );
+            check( it != end(), error_msg );
+            return *it;
+         }
+
+         template<name::raw IndexName>
+         auto get_index() const {
+            constexpr size_t I = index_position<static_cast<uint64_t>(IndexName)>();
+            static_assert( I < sizeof...(Indices), "name not a valid index" );
+            return index<I>( _store.get() );
+         }
+
+         template<typename Lambda>
+         const_iterator emplace( name payer, Lambda&& constructor ) {
+            check( payer != name(), "must specify a valid account to pay for new record" );
+            T obj{};
+            constructor( obj );
+            const uint64_t pk = obj.primary_key();
+            auto res = _store->rows.emplace( pk, std::move(obj) );
+            check( res.second, "could not insert object, most likely a uniqueness constraint was violated" );
+            insert_keys( res.first->second, std::index_sequence_for<Indices...>{} );
+            native::count_write( 1 + sizeof...(Indices) );
+            return const_iterator( res.first );
+         }
+
+         template<typename Lambda>
+         void modify( const_iterator itr, name payer, Lambda&& updater ) {
+            check( itr != end(), "cannot pass end iterator to modify" );
+            modify( *itr, payer, std::forward<Lambda&&>(updater) );
+         }
+
+         template<typename Lambda>
+         void modify( const T& obj, name, Lambda&& updater ) {
+            const uint64_t pk = obj.primary_key();
+            auto it = _store->rows.find( pk );
+            check( it != _store->rows.end() && &it->second == &obj, "object passed to modify is not in multi_index" );
+            auto old_keys = keys_of( obj, std::index_sequence_for<Indices...>{} );
+            updater( it->second );
+            check( pk == it->second.primary_key(), "updater cannot change primary key when modifying an object" );
+            native::count_write();
+            update_keys( old_keys, it->second, std::index_sequence_for<Indices...>{} );
+         }
+
+         const_iterator erase( const_iterator itr ) {
+            check( itr != end(), "cannot pass end iterator to erase" );
+            erase_keys( *itr, std::index_sequence_for<Indices...>{} );
+            native::count_write( 1 + sizeof...(Indices) );
+            return const_iterator( _store->rows.erase( itr._it ) );
+         }
+
+         void erase( const T& obj ) {
+            auto it = _store->rows.find( obj.primary_key() );
+            check( it != _store->rows.end(), "object passed to erase is not in multi_index" );
+            erase( const_iterator( it ) );
+         }
+   };
+
+} /// namespace eosio
@@ -0,0 +1,75 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib name for host benchmarks.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace eosio {
+
+   typedef __int128          int128_t;
+   typedef unsigned __int128 uint128_t;
+
+   struct name {
+      enum class raw : uint64_t {};
+
+      constexpr name() : value(0) {}
+      constexpr explicit name( uint64_t v ) : value(v) {}
+      constexpr explicit name( raw r ) : value(static_cast<uint64_t>(r)) {}
+      constexpr explicit name( std::string_view str ) : value(0) {
+         int n = 0;
+         for( ; n < 12 && n < int(str.size()); ++n ) {
+            value <<= 5;
+            value |= char_to_value( str[n] );
+         }
+         value <<= ( 4 + 5*(12 - n) );
+         if( str.size() == 13 ) {
+            value |= char_to_value( str[12] ) & 0x0F;
+         }
+      }
+
+      static constexpr uint8_t char_to_value( char c ) {
+         if( c == '.' )
+            return 0;
+         else if( c >= '1' && c <= '5' )
+            return (c - '1') + 1;
+         else if( c >= 'a' && c <= 'z' )
+            return (c - 'a') + 6;
+         return 0;
+      }
+
+      constexpr operator raw() const { return raw(value); }
+      constexpr explicit operator bool() const { return value != 0; }
+
+      std::string to_string() const {
+         static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+         std::string str( 13, '.' );
+         uint64_t tmp = value;
+         for( uint32_t i = 0; i <= 12; ++i ) {
+            char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+            str[12-i] = c;
+            tmp >>= (i == 0 ? 4 : 5);
+         }
+         auto last = str.find_last_not_of( '.' );
+         return last == std::string::npos ? std::string() : str.substr( 0, last + 1 );
+      }
+
+      friend constexpr bool operator == ( const name& a, const name& b ) { return a.value == b.value; }
+      friend constexpr bool operator != ( const name& a, const name& b ) { return a.value != b.value; }
+      friend constexpr bool operator < ( const name& a, const name& b ) { return a.value < b.value; }
+
+      uint64_t value;
+   };
+
+   static constexpr name same_payer{};
+
+} /// namespace eosio
+
+template <typename T, T... Str>
+inline constexpr eosio::name operator""_n() {
+   constexpr const char buf[] = { Str... };
+   return eosio::name{ std::string_view{ buf, sizeof...(Str) } };
+}
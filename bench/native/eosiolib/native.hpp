@@ -0,0 +1,128 @@
+/**
+ *  @file
+ *  In-memory chain state backing the native eosiolib stand-in: accounts, the authorization
+ *  of the running action, queued inline actions and per-intrinsic counters.
+ */
+#pragma once
+
+#include <eosiolib/name.hpp>
+#include <eosiolib/system.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace eosio {
+
+   struct permission_level {
+      permission_level( name a, name p ) : actor(a), permission(p) {}
+      permission_level() {}
+
+      name actor;
+      name permission;
+   };
+
+   namespace native {
+
+      // intrinsic calls a contract would have made, reset by the benchmark between runs
+      struct counters {
+         uint64_t actions       = 0;   // top level plus inline actions
+         uint64_t notifications = 0;   // require_recipient calls
+         uint64_t db_reads      = 0;   // find, lowerbound, next, previous and get calls
+         uint64_t db_writes     = 0;   // store, update and remove calls, secondary indexes included
+         uint64_t auth_checks   = 0;   // require_auth, has_auth and is_account calls
+      };
+
+      struct chain {
+         std::set<uint64_t>                                                       accounts;
+         std::vector<permission_level>                                            auths;
+         std::vector<std::function<void()>>*                                      inlines = nullptr;
+         std::map<uint64_t, uint64_t>                                             executed;
+         std::map<std::tuple<uint64_t, uint64_t, uint64_t>, std::shared_ptr<void>> tables;
+         counters                                                                 stats;
+         uint64_t                                                                 now_us = 0;   // current_time() of the running block
+      };
+
+      inline chain& state() {
+         static chain c;
+         return c;
+      }
+
+      inline void reset() {
+         state() = chain{};
+      }
+
+      // runs one action, then its inline actions depth first as nodeos does. A failing check
+      // propagates to the caller, rows already written are not rolled back.
+      inline void execute( name act, const std::vector<permission_level>& auths, const std::function<void()>& body ) {
+         auto& c = state();
+         std::vector<std::function<void()>> queued;
+         struct restore {
+            chain&                               c;
+            std::vector<permission_level>        auths;
+            std::vector<std::function<void()>>*  inlines;
+            ~restore() { c.auths = auths; c.inlines = inlines; }
+         } saved{ c, c.auths, c.inlines };
+         c.auths = auths;
+         c.inlines = &queued;
+         ++c.stats.actions;
+         ++c.executed[act.value];
+         body();
+         c.auths = saved.auths;
+         c.inlines = saved.inlines;
+         for( auto& q : queued ) {
+            q();
+         }
+      }
+
+      template <typename T>
+      inline std::shared_ptr<T> table( uint64_t code, uint64_t scope, uint64_t table_name ) {
+         auto& t = state().tables[ std::make_tuple( code, scope, table_name ) ];
+         if( !t ) {
+            t = std::make_shared<T>();
+         }
+         return std::static_pointer_cast<T>( t );
+      }
+
+   } /// namespace native
+
+   inline void require_auth( name n ) {
+      auto& c = native::state();
+      ++c.stats.auth_checks;
+      for( const auto& a : c.auths ) {
+         if( a.actor == n ) {
+            return;
+         }
+      }
+      check( false, "missing authority of " + n.to_string() );
+   }
+
+   inline bool has_auth( name n ) {
+      auto& c = native::state();
+      ++c.stats.auth_checks;
+      for( const auto& a : c.auths ) {
+         if( a.actor == n ) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   inline bool is_account( name n ) {
+      auto& c = native::state();
+      ++c.stats.auth_checks;
+      return c.accounts.count( n.value ) > 0;
+   }
+
+   inline void require_recipient( name ) {
+      ++native::state().stats.notifications;
+   }
+
+} /// namespace eosio
+
+inline uint64_t current_time() {
+   return eosio::native::state().now_us;
+}
@@ -0,0 +1,20 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib public_key for host benchmarks.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace eosio {
+
+   struct public_key {
+      uint32_t              type = 0;
+      std::array<char, 33>  data{};
+
+      friend bool operator == ( const public_key& a, const public_key& b ) { return a.type == b.type && a.data == b.data; }
+      friend bool operator != ( const public_key& a, const public_key& b ) { return !( a == b ); }
+   };
+
+} /// namespace eosio
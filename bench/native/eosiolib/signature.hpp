@@ -0,0 +1,17 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib signature for host benchmarks.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace eosio {
+
+   struct signature {
+      uint32_t              type = 0;
+      std::array<char, 65>  data{};
+   };
+
+} /// namespace eosio
@@ -0,0 +1,28 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib check for host benchmarks, assertions throw instead of aborting.
+ */
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace eosio {
+
+   struct eosio_assert_exception : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline void check( bool pred, const char* msg ) {
+      if( !pred ) {
+         throw eosio_assert_exception( msg );
+      }
+   }
+
+   inline void check( bool pred, const std::string& msg ) {
+      if( !pred ) {
+         throw eosio_assert_exception( msg );
+      }
+   }
+
+} /// namespace eosio
@@ -0,0 +1,50 @@
+/**
+ *  @file
+ *  Native stand-in of eosiolib time types for host benchmarks.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace eosio {
+
+   class microseconds {
+      public:
+         explicit microseconds( int64_t c = 0 ) : _count(c) {}
+
+         int64_t count() const { return _count; }
+
+      private:
+         int64_t _count;
+   };
+
+   class time_point {
+      public:
+         explicit time_point( microseconds e = microseconds() ) : elapsed(e) {}
+
+         const microseconds& time_since_epoch() const { return elapsed; }
+         uint32_t sec_since_epoch() const { return uint32_t( elapsed.count() / 1000000 ); }
+
+      private:
+         microseconds elapsed;
+   };
+
+   class time_point_sec {
+      public:
+         time_point_sec() : utc_seconds(0) {}
+         explicit time_point_sec( uint32_t seconds ) : utc_seconds(seconds) {}
+         time_point_sec( const time_point& t ) : utc_seconds( t.sec_since_epoch() ) {}
+
+         uint32_t sec_since_epoch() const { return utc_seconds; }
+
+         friend bool operator == ( const time_point_sec& a, const time_point_sec& b ) { return a.utc_seconds == b.utc_seconds; }
+         friend bool operator != ( const time_point_sec& a, const time_point_sec& b ) { return a.utc_seconds != b.utc_seconds; }
+         friend bool operator < ( const time_point_sec& a, const time_point_sec& b ) { return a.utc_seconds < b.utc_seconds; }
+         friend bool operator <= ( const time_point_sec& a, const time_point_sec& b ) { return a.utc_seconds <= b.utc_seconds; }
+         friend bool operator > ( const time_point_sec& a, const time_point_sec& b ) { return a.utc_seconds > b.utc_seconds; }
+         friend bool operator >= ( const time_point_sec& a, const time_point_sec& b ) { return a.utc_seconds >= b.utc_seconds; }
+
+         uint32_t utc_seconds;
+   };
+
+} /// namespace eosio
@@ -0,0 +1,183 @@
+/**
+ *  @file
+ *  Host benchmarks of eosio.token. Every action runs through the in-memory eosiolib in
+ *  native/, which counts the db intrinsics it would have called on chain. Those counts are
+ *  reported per iteration next to wall time, so a change in db traffic shows up in CI even
+ *  when timing noise hides it.
+ */
+#include <eosio.token/eosio.token.hpp>
+
+#include <benchmark/benchmark.h>
+
+using namespace eosio;
+
+namespace {
+
+   const symbol core_symbol( "HOT", 6 );
+   const name   token_account( "eosio.token" );
+   const name   issuer( "eosio" );
+   const name   stake_account( "eosio.stake" );
+   const name   saving_account( "eosio.saving" );
+
+   // every holder starts with 100 HOT
+   const int64_t holder_balance = 100'000000;
+
+   // HOT_BONUS_SHARDS of eosio.token.cpp
+   const uint8_t bonus_shards = 8;
+
+   int64_t world_holders = -1;
+
+   name holder( int64_t i ) {
+      // any 64 bit value is a valid account here, keep clear of the named system accounts
+      return name( ( uint64_t(i) + 1 ) << 8 );
+   }
+
+   asset core( int64_t amount ) {
+      return asset( amount, core_symbol );
+   }
+
+   std::vector<permission_level> active( name n ) {
+      return { { n, name("active") } };
+   }
+
+   // chain with HOT created and spread over `holders` accounts, rebuilt only when the size changes
+   void setup_world( int64_t holders ) {
+      if ( world_holders == holders ) {
+         return;
+      }
+      native::reset();
+      auto& c = native::state();
+      for ( name n : { token_account, issuer, stake_account, saving_account } ) {
+         c.accounts.insert( n.value );
+      }
+      for ( int64_t i = 0; i < holders; ++i ) {
+         c.accounts.insert( holder(i).value );
+      }
+
+      native::push_action( token_account, name("create"), &token::create, active( token_account ),
+                           issuer, core( asset::max_amount ) );
+      native::push_action( token_account, name("issue"), &token::issue, active( issuer ),
+                           issuer, core( holders * holder_balance ), std::string() );
+      // genesis in batches of 1000 receivers
+      std::vector<token::issue_param> issues;
+      for ( int64_t i = 0; i < holders; ++i ) {
+         issues.push_back( token::issue_param{ holder(i), core( holder_balance ) } );
+         if ( issues.size() == 1000 || i + 1 == holders ) {
+            native::push_action( token_account, name("issuemany"), &token::issuemany, active( issuer ),
+                                 issues, std::string( "genesis" ) );
+            issues.clear();
+         }
+      }
+      world_holders = holders;
+   }
+
+   // per iteration counters of everything the benchmark loop executed
+   void report( benchmark::State& state, int64_t per_iteration_actions = 1 ) {
+      const auto& s = native::state().stats;
+      const auto avg = benchmark::Counter::kAvgIterations;
+      state.counters["actions"]       = benchmark::Counter( double(s.actions), avg );
+      state.counters["notifications"] = benchmark::Counter( double(s.notifications), avg );
+      state.counters["db_reads"]      = benchmark::Counter( double(s.db_reads), avg );
+      state.counters["db_writes"]     = benchmark::Counter( double(s.db_writes), avg );
+      state.counters["db_ops/action"] = s.actions ? double(s.db_reads + s.db_writes) / double(s.actions) : 0.0;
+      state.SetItemsProcessed( state.iterations() * per_iteration_actions );
+   }
+
+   void BM_transfer( benchmark::State& state ) {
+      const int64_t holders = state.range(0);
+      setup_world( holders );
+      native::state().stats = {};
+
+      int64_t i = 0;
+      for ( auto _ : state ) {
+         const name from = holder( i % holders );
+         const name to   = holder( ( i + 1 ) % holders );
+         native::push_action( token_account, name("transfer"), &token::transfer, active( from ),
+                              from, to, core( 100 ), std::string( "bench" ) );
+         ++i;
+      }
+      report( state );
+   }
+
+   void BM_staketrans( benchmark::State& state ) {
+      const int64_t holders = state.range(0);
+      setup_world( holders );
+      native::state().stats = {};
+
+      int64_t i = 0;
+      for ( auto _ : state ) {
+         // stakes to the next holder, the tokens themselves move to eosio.stake
+         const name from = holder( i % holders );
+         const name to   = holder( ( i + 1 ) % holders );
+         native::push_action( token_account, name("staketrans"), &token::staketrans, active( from ),
+                              from, to, core( 100 ), std::string( "bench" ) );
+         ++i;
+      }
+      report( state );
+   }
+
+   // one iteration is a whole round, bonusfreeze and then clearing until bonusclose ran
+   template<typename Clear>
+   void bonus_round( benchmark::State& state, Clear&& clear ) {
+      const int64_t holders = state.range(0);
+      setup_world( holders );
+      auto& c = native::state();
+      c.stats = {};
+
+      for ( auto _ : state ) {
+         native::push_action( token_account, name("bonusfreeze"), &token::bonusfreeze, active( issuer ),
+                              core( holders * 1000 ), core( 1 ), saving_account );
+         const uint64_t closed = c.executed[ name("bonusclose").value ];
+         while ( c.executed[ name("bonusclose").value ] == closed ) {
+            clear();
+         }
+      }
+      report( state, holders );
+   }
+
+   // shards are cleared round robin, as side by side transactions would
+   void BM_bonusclear( benchmark::State& state ) {
+      uint8_t shard = 0;
+      bonus_round( state, [&]() {
+         try {
+            native::push_action( token_account, name("bonusclear"), &token::bonusclear, active( issuer ), shard );
+         } catch ( const eosio_assert_exception& ) {
+            // shard is already cleared, it fails before writing anything
+         }
+         shard = ( shard + 1 ) % bonus_shards;
+      });
+   }
+
+   void BM_bonusbulk( benchmark::State& state ) {
+      bonus_round( state, []() {
+         native::push_action( token_account, name("bonusbulk"), &token::bonusbulk, active( issuer ),
+                              uint32_t(500) );
+      });
+   }
+
+   // lazy engine for comparison, one accrual and one claim per iteration
+   void BM_bonusaccrue( benchmark::State& state ) {
+      const int64_t holders = state.range(0);
+      setup_world( holders );
+      native::state().stats = {};
+
+      int64_t i = 0;
+      for ( auto _ : state ) {
+         native::push_action( token_account, name("bonusaccrue"), &token::bonusaccrue, active( issuer ),
+                              core( holders * 1000 ) );
+         const name owner = holder( i % holders );
+         native::push_action( token_account, name("claimbonus"), &token::claimbonus, active( owner ), owner );
+         ++i;
+      }
+      report( state, 2 );
+   }
+
+} /// namespace
+
+BENCHMARK( BM_transfer )->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 );
+BENCHMARK( BM_staketrans )->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 );
+BENCHMARK( BM_bonusclear )->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 )->Iterations( 1 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_bonusbulk )->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 )->Iterations( 1 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_bonusaccrue )->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 );
+
+BENCHMARK_MAIN();
@@ -2,11 +2,14 @@
 
 #include <eosio.system/native.hpp>
 #include <eosiolib/asset.hpp>
+#include <eosiolib/binary_extension.hpp>
+#include <eosiolib/crypto.hpp>
 #include <eosiolib/time.hpp>
 #include <eosiolib/privileged.hpp>
 #include <eosiolib/singleton.hpp>
 #include <eosio.system/exchange_state.hpp>
 
+#include <array>
 #include <string>
 #include <deque>
 #include <type_traits>
@@ -114,17 +117,29 @@ namespace eosiosystem {
       block_timestamp   last_block_num; /* deprecated */
       double            total_producer_votepay_share = 0;
       uint8_t           revision = 0; ///< used to track version updates in the future.
+      eosio::binary_extension<eosio::checksum256> last_proposed_schedule_hash; ///< sha256 of the last packed producer schedule proposed
 
       EOSLIB_SERIALIZE( eosio_global_state2, (new_ram_per_block)(last_ram_increase)(last_block_num)
-                        (total_producer_votepay_share)(revision) )
+                        (total_producer_votepay_share)(revision)(last_proposed_schedule_hash) )
    };
 
    struct [[eosio::table("global3"), eosio::contract("eosio.system")]] eosio_global_state3 {
       eosio_global_state3() { }
       time_point        last_vpay_state_update;
       double            total_vpay_share_change_rate = 0;
+      eosio::binary_extension<bool> unified_producers; ///< set by migrateprods, new votepay state goes to producer_info
 
-      EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate) )
+      EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate)(unified_producers) )
+   };
+
+   /**
+    * Votepay state of a producer, kept in producer_info once migrated out of producers2
+    */
+   struct producer_votepay {
+      double          votepay_share = 0;
+      time_point      last_votepay_share_update;
+
+      EOSLIB_SERIALIZE( producer_votepay, (votepay_share)(last_votepay_share_update) )
    };
 
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info {
@@ -136,6 +151,7 @@ namespace eosiosystem {
       uint32_t              unpaid_blocks = 0;
       time_point            last_claim_time;
       uint16_t              location = 0;
+      eosio::binary_extension<producer_votepay> votepay; ///< replaces the producers2 row of the producer
 
       uint64_t primary_key()const { return owner.value;                             }
       double   by_votes()const    { return is_active ? -total_votes : total_votes;  }
@@ -144,7 +160,7 @@ namespace eosiosystem {
 
       // explicit serialization macro is not necessary, used here only to improve compilation time
       EOSLIB_SERIALIZE( producer_info, (owner)(total_votes)(producer_key)(is_active)(url)
-                        (unpaid_blocks)(last_claim_time)(location) )
+                        (unpaid_blocks)(last_claim_time)(location)(votepay) )
    };
 
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info2 {
@@ -158,6 +174,20 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( producer_info2, (owner)(votepay_share)(last_votepay_share_update) )
    };
 
+   /**
+    * Per-block producer counters kept apart from producer_info so that onblock does not
+    * rewrite the key, url and vote index of the producer every block
+    */
+   struct [[eosio::table, eosio::contract("eosio.system")]] producer_counter {
+      name              owner;
+      uint32_t          unpaid_blocks = 0; /// blocks produced since the last claimrewards
+      block_timestamp   last_block_time;
+
+      uint64_t primary_key()const { return owner.value; }
+
+      EOSLIB_SERIALIZE( producer_counter, (owner)(unpaid_blocks)(last_block_time) )
+   };
+
    struct [[eosio::table, eosio::contract("eosio.system")]] voter_info {
       name                owner;     /// the voter
       name                proxy;     /// the proxy set by the voter, if any
@@ -197,17 +227,83 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "voters"_n, voter_info >  voters_table;
 
+   /**
+    * Votes cast for a migrated producer that are not yet added to its total_votes. They are
+    * folded in by update_elected_producers before it ranks producers, by flushvotes or when its
+    * votepay state changes.
+    */
+   struct [[eosio::table, eosio::contract("eosio.system")]] pending_votes {
+      name     owner;
+      double   delta = 0;       /// sum of the vote changes
+      double   delta_time = 0;  /// sum of each change times the seconds it was cast after last_votepay_share_update
+
+      uint64_t primary_key()const { return owner.value; }
+
+      EOSLIB_SERIALIZE( pending_votes, (owner)(delta)(delta_time) )
+   };
+
+   typedef eosio::multi_index< "pendingvotes"_n, pending_votes > pending_votes_table;
+
 
    typedef eosio::multi_index< "producers"_n, producer_info,
                                indexed_by<"prototalvote"_n, const_mem_fun<producer_info, double, &producer_info::by_votes>  >
                              > producers_table;
    typedef eosio::multi_index< "producers2"_n, producer_info2 > producers_table2;
+   typedef eosio::multi_index< "prodcounter"_n, producer_counter > producer_counters_table;
 
    typedef eosio::singleton< "global"_n, eosio_global_state >   global_state_singleton;
    typedef eosio::singleton< "global2"_n, eosio_global_state2 > global_state2_singleton;
    typedef eosio::singleton< "global3"_n, eosio_global_state3 > global_state3_singleton;
 
+   /**
+    * Global state singleton that is read on first access and written back by the
+    * system_contract destructor only if an action asked for it through get_mut().
+    */
+   template <typename Singleton, typename T>
+   class lazy_global {
+      public:
+         lazy_global( name code, uint64_t scope, T (*make_default)() = nullptr )
+         :_singleton(code, scope), _make_default(make_default) {}
+
+         const T& get()const { return load(); }
+         T& get_mut() { _dirty = true; return load(); }
+
+         void save( name payer ) {
+            if( _dirty )
+               _singleton.set( *_state, payer );
+         }
+
+      private:
+         T& load()const {
+            if( !_state ) {
+               if( _singleton.exists() )
+                  _state = _singleton.get();
+               else
+                  _state = _make_default ? _make_default() : T{};
+            }
+            return *_state;
+         }
+
+         mutable Singleton         _singleton;
+         mutable std::optional<T>  _state;
+         T                       (*_make_default)();
+         bool                      _dirty = false;
+   };
+
    static constexpr uint32_t     seconds_per_day = 24 * 3600;
+   static constexpr uint32_t     num_of_maturity_buckets = 5;
+
+   /**
+    * Summary of pending REX maintenance and its budgets, lets REX actions skip runrex when nothing is due
+    */
+   struct rex_maintenance {
+      time_point_sec  next_expiration;      ///< no cpu or net loan expires before this time
+      bool            open_orders = true;   ///< queued sellrex orders may be waiting to be filled
+      uint16_t        max_per_action = 2;   ///< items of each kind processed by a user REX action
+      uint16_t        max_per_block = 0;    ///< items of each kind processed by onblock, 0 disables
+
+      EOSLIB_SERIALIZE( rex_maintenance, (next_expiration)(open_orders)(max_per_action)(max_per_block) )
+   };
 
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_pool {
       uint8_t    version = 0;
@@ -218,8 +314,17 @@ namespace eosiosystem {
       asset      total_rex; /// total number of REX shares allocated to contributors to total_lendable
       asset      namebid_proceeds; /// the amount of CORE_SYMBOL to be transferred from namebids to REX pool
       uint64_t   loan_num = 0; /// increments with each new loan
+      eosio::binary_extension<rex_maintenance> maintenance; /// written by the first runrex or setrexmaint
 
       uint64_t primary_key()const { return 0; }
+
+      rex_maintenance& maintenance_mut() {
+         if ( !maintenance.has_value() ) maintenance.emplace();
+         return maintenance.value();
+      }
+
+      EOSLIB_SERIALIZE( rex_pool, (version)(total_lent)(total_unlent)(total_rent)(total_lendable)
+                        (total_rex)(namebid_proceeds)(loan_num)(maintenance) )
    };
 
    typedef eosio::multi_index< "rexpool"_n, rex_pool > rex_pool_table;
@@ -234,15 +339,33 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "rexfund"_n, rex_fund > rex_fund_table;
 
+   /**
+    * Fixed size REX maturity buckets of a version 1 rex_balance, REX maturing at the start of
+    * day d (utc seconds / seconds_per_day) is kept in days[d % num_of_maturity_buckets]
+    */
+   struct rex_maturity_slots {
+      uint32_t                                     last_day = 0; ///< buckets of days up to this one are in matured_rex
+      std::array<int64_t, num_of_maturity_buckets> days{};       ///< REX maturing on days last_day + 1 to last_day + num_of_maturity_buckets
+      int64_t                                      savings = 0;  ///< REX savings bucket, never matures
+
+      /// bucket of REX bought on last_day, it matures num_of_maturity_buckets days later
+      int64_t& newest() { return days[last_day % num_of_maturity_buckets]; }
+
+      EOSLIB_SERIALIZE( rex_maturity_slots, (last_day)(days)(savings) )
+   };
+
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_balance {
       uint8_t version = 0;
       name    owner;
       asset   vote_stake; /// the amount of CORE_SYMBOL currently included in owner's vote
       asset   rex_balance; /// the amount of REX owned by owner
       int64_t matured_rex = 0; /// matured REX available for selling
-      std::deque<std::pair<time_point_sec, int64_t>> rex_maturities; /// REX daily maturity buckets
+      std::deque<std::pair<time_point_sec, int64_t>> rex_maturities; /// REX daily maturity buckets, version 0 only
+      eosio::binary_extension<rex_maturity_slots> maturity_slots; /// REX daily maturity buckets, version 1
 
       uint64_t primary_key()const { return owner.value; }
+
+      EOSLIB_SERIALIZE( rex_balance, (version)(owner)(vote_stake)(rex_balance)(matured_rex)(rex_maturities)(maturity_slots) )
    };
 
    typedef eosio::multi_index< "rexbal"_n, rex_balance > rex_balance_table;
@@ -258,7 +381,8 @@ namespace eosiosystem {
       eosio::time_point   expiration;
 
       uint64_t primary_key()const { return loan_num;                   }
-      uint64_t by_expr()const     { return expiration.elapsed.count(); }
+      /// version 1 loans are scheduled in loanexpiry, their byexpr key never changes
+      uint64_t by_expr()const     { return version == 0 ? expiration.elapsed.count() : std::numeric_limits<uint64_t>::max(); }
       uint64_t by_owner()const    { return from.value;                 }
    };
 
@@ -272,6 +396,21 @@ namespace eosiosystem {
                                indexed_by<"byowner"_n, const_mem_fun<rex_loan, uint64_t, &rex_loan::by_owner>>
                              > rex_net_loan_table;
 
+   /**
+    * Expiration schedule of version 1 REX loans, scoped by loan table name. Slots are ordered by
+    * expiration second, so loans expiring on the same day form a contiguous range that runrex
+    * pops from the front.
+    */
+   struct [[eosio::table,eosio::contract("eosio.system")]] rex_loan_expiry {
+      uint64_t  slot;     /// expiration in seconds in the upper 32 bits, loan_num in the lower ones
+      uint64_t  loan_num;
+
+      uint64_t primary_key()const        { return slot; }
+      time_point_sec expiration()const   { return time_point_sec( uint32_t(slot >> 32) ); }
+   };
+
+   typedef eosio::multi_index< "loanexpiry"_n, rex_loan_expiry > rex_loan_expiry_table;
+
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_order {
       uint8_t             version = 0;
       name                owner;
@@ -289,6 +428,20 @@ namespace eosiosystem {
    typedef eosio::multi_index< "rexqueue"_n, rex_order,
                                indexed_by<"bytime"_n, const_mem_fun<rex_order, uint64_t, &rex_order::by_time>>> rex_order_table;
 
+   /**
+    * Latest REX result of an owner who opted out of rex.results inline actions with setrexresult
+    */
+   struct [[eosio::table,eosio::contract("eosio.system")]] rex_result {
+      name      owner;
+      name      action;        /// action that produced the result
+      asset     result;        /// REX bought, sellrex proceeds or tokens rented
+      uint64_t  sequence = 0;  /// increments with each result
+
+      uint64_t primary_key()const { return owner.value; }
+   };
+
+   typedef eosio::multi_index< "rexresult"_n, rex_result > rex_result_table;
+
    struct rex_order_outcome {
       bool success;
       asset proceeds;
@@ -301,12 +454,11 @@ namespace eosiosystem {
          voters_table            _voters;
          producers_table         _producers;
          producers_table2        _producers2;
-         global_state_singleton  _global;
-         global_state2_singleton _global2;
-         global_state3_singleton _global3;
-         eosio_global_state      _gstate;
-         eosio_global_state2     _gstate2;
-         eosio_global_state3     _gstate3;
+         producer_counters_table _prodcounters;
+         pending_votes_table     _pendingvotes;
+         lazy_global<global_state_singleton, eosio_global_state>   _gstate;
+         lazy_global<global_state2_singleton, eosio_global_state2> _gstate2;
+         lazy_global<global_state3_singleton, eosio_global_state3> _gstate3;
          rammarket               _rammarket;
          rex_pool_table          _rexpool;
          rex_fund_table          _rexfunds;
@@ -462,6 +614,14 @@ namespace eosiosystem {
          [[eosio::action]]
          void rexexec( const name& user, uint16_t max );
 
+         /**
+          * Sets how many CPU loans, NET loans and queued sellrex orders each user REX action
+          * and each block process while REX maintenance is due. A zero max_per_action leaves
+          * maintenance to onblock and rexexec.
+          */
+         [[eosio::action]]
+         void setrexmaint( uint16_t max_per_action, uint16_t max_per_block );
+
          /**
           * Consolidate REX maturity buckets into one that can be sold only 4 days
           * from the end of today.
@@ -492,6 +652,13 @@ namespace eosiosystem {
          [[eosio::action]]
          void closerex( const name& owner );
 
+         /**
+          * With use_row set, results of owner buyrex, unstaketorex, sellrex, rentcpu and rentnet
+          * overwrite a rexresult row instead of being sent as rex.results inline actions.
+          */
+         [[eosio::action]]
+         void setrexresult( const name& owner, bool use_row );
+
          /**
           *  Decreases the total tokens delegated by from to receiver and/or
           *  frees the memory associated with the delegation if there is nothing
@@ -556,6 +723,12 @@ namespace eosiosystem {
          [[eosio::action]]
          void regproxy( const name proxy, bool isproxy );
 
+         /**
+          * Folds up to max pending vote changes into the total_votes of their producers.
+          */
+         [[eosio::action]]
+         void flushvotes( const name& user, uint16_t max );
+
          [[eosio::action]]
          void setparams( const eosio::blockchain_parameters& params );
 
@@ -572,6 +745,13 @@ namespace eosiosystem {
          [[eosio::action]]
          void updtrevision( uint8_t revision );
 
+         /**
+          * Moves the votepay state of up to max producers from producers2 into their
+          * producers row. Producers registered afterwards only get the producers row.
+          */
+         [[eosio::action]]
+         void migrateprods( uint16_t max );
+
          [[eosio::action]]
          void bidname( name bidder, name newname, asset bid );
 
@@ -598,10 +778,12 @@ namespace eosiosystem {
          using updaterex_action = eosio::action_wrapper<"updaterex"_n, &system_contract::updaterex>;
          using rexexec_action = eosio::action_wrapper<"rexexec"_n, &system_contract::rexexec>;
          using setrex_action = eosio::action_wrapper<"setrex"_n, &system_contract::setrex>;
+         using setrexmaint_action = eosio::action_wrapper<"setrexmaint"_n, &system_contract::setrexmaint>;
          using mvtosavings_action = eosio::action_wrapper<"mvtosavings"_n, &system_contract::mvtosavings>;
          using mvfrsavings_action = eosio::action_wrapper<"mvfrsavings"_n, &system_contract::mvfrsavings>;
          using consolidate_action = eosio::action_wrapper<"consolidate"_n, &system_contract::consolidate>;
          using closerex_action = eosio::action_wrapper<"closerex"_n, &system_contract::closerex>;
+         using setrexresult_action = eosio::action_wrapper<"setrexresult"_n, &system_contract::setrexresult>;
          using undelegatebw_action = eosio::action_wrapper<"undelegatebw"_n, &system_contract::undelegatebw>;
          using buyram_action = eosio::action_wrapper<"buyram"_n, &system_contract::buyram>;
          using buyrambytes_action = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
@@ -613,9 +795,11 @@ namespace eosiosystem {
          using setramrate_action = eosio::action_wrapper<"setramrate"_n, &system_contract::setramrate>;
          using voteproducer_action = eosio::action_wrapper<"voteproducer"_n, &system_contract::voteproducer>;
          using regproxy_action = eosio::action_wrapper<"regproxy"_n, &system_contract::regproxy>;
+         using flushvotes_action = eosio::action_wrapper<"flushvotes"_n, &system_contract::flushvotes>;
          using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
          using rmvproducer_action = eosio::action_wrapper<"rmvproducer"_n, &system_contract::rmvproducer>;
          using updtrevision_action = eosio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
+         using migrateprods_action = eosio::action_wrapper<"migrateprods"_n, &system_contract::migrateprods>;
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
          using bidrefund_action = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
@@ -642,32 +826,40 @@ namespace eosiosystem {
 
          // defined in rex.cpp
          void runrex( uint16_t max );
+         void runrex_if_due( bool onblock = false );
+         rex_maintenance get_rex_maintenance()const;
+         bool rex_maintenance_due()const;
          void update_resource_limits( const name& from, const name& receiver, int64_t delta_net, int64_t delta_cpu );
          void check_voting_requirement( const name& owner,
                                         const char* error_msg = "must vote for at least 21 producers or for a proxy before buying REX" )const;
          rex_order_outcome fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex );
+         rex_order_outcome fill_rex_sale( const rex_balance_table::const_iterator& bitr, int64_t rex, int64_t lent,
+                                          int64_t& S, int64_t& R, int64_t& unlent );
+         void fill_rex_orders( uint16_t max );
          asset update_rex_account( const name& owner, const asset& proceeds, const asset& unstake_quant, bool force_vote_update = false );
          void channel_to_rex( const name& from, const asset& amount );
          void channel_namebid_to_rex( const int64_t highest_bid );
          template <typename T>
-         int64_t rent_rex( T& table, const name& from, const name& receiver, const asset& loan_payment, const asset& loan_fund );
+         int64_t rent_rex( T& table, const name& table_name, const name& from, const name& receiver,
+                           const asset& loan_payment, const asset& loan_fund );
+         void schedule_rex_loan( const name& table_name, const rex_loan& loan );
          template <typename T>
          void fund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& payment );
          template <typename T>
          void defund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& amount );
+         bool record_rex_result( const name& owner, const name& act, const asset& result );
          void transfer_from_fund( const name& owner, const asset& amount );
          void transfer_to_fund( const name& owner, const asset& amount );
          bool rex_loans_available()const;
          bool rex_system_initialized()const { return _rexpool.begin() != _rexpool.end(); }
          bool rex_available()const { return rex_system_initialized() && _rexpool.begin()->total_rex.amount > 0; }
-         static time_point_sec get_rex_maturity();
+         static uint32_t get_rex_day();
+         static rex_maturity_slots& get_rex_maturity_slots( rex_balance& rb );
          asset add_to_rex_balance( const name& owner, const asset& payment, const asset& rex_received );
          asset add_to_rex_pool( const asset& payment );
          void process_rex_maturities( const rex_balance_table::const_iterator& bitr );
          void consolidate_rex_balance( const rex_balance_table::const_iterator& bitr,
                                        const asset& rex_in_sell_order );
-         int64_t read_rex_savings( const rex_balance_table::const_iterator& bitr );
-         void put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex );
          void update_rex_stake( const name& voter );
 
          void add_loan_to_rex_pool( const asset& payment, int64_t rented_tokens, bool new_loan );
@@ -687,6 +879,17 @@ namespace eosiosystem {
          double update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
                                                time_point ct,
                                                double shares_rate, bool reset_to_zero = false );
+         static double accrue_votepay_share( producer_votepay& votepay, time_point ct,
+                                             double shares_rate, bool reset_to_zero );
+         void update_producer_votes( const producer_info& prod, double delta, time_point ct, bool clamp_to_zero,
+                                     double& delta_change_rate, double& total_inactive_vpay_share );
+         void fold_pending_votes( const pending_votes_table::const_iterator& pv, const producer_info& prod, time_point ct,
+                                  double& delta_change_rate, double& total_inactive_vpay_share );
+         void flush_pending_votes( uint32_t max );
+         bool unified_producers()const {
+            const auto& gs3 = _gstate3.get();
+            return gs3.unified_producers.has_value() && gs3.unified_producers.value();
+         }
          double update_total_votepay_share( time_point ct,
                                             double additional_shares_delta = 0.0, double shares_rate_delta = 0.0 );
 
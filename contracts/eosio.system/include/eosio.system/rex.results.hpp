@@ -25,8 +25,12 @@ class [[eosio::contract("rex.results")]] rex_results : eosio::contract {
       [[eosio::action]]
       void rentresult( const asset& rented_tokens );
 
+      [[eosio::action]]
+      void batchresult( const std::vector<std::pair<name, asset>>& filled_orders );
+
       using buyresult_action   = action_wrapper<"buyresult"_n,   &rex_results::buyresult>;
       using sellresult_action  = action_wrapper<"sellresult"_n,  &rex_results::sellresult>;
       using orderresult_action = action_wrapper<"orderresult"_n, &rex_results::orderresult>;
       using rentresult_action  = action_wrapper<"rentresult"_n,  &rex_results::rentresult>;
+      using batchresult_action = action_wrapper<"batchresult"_n, &rex_results::batchresult>;
 };
@@ -140,8 +140,8 @@ namespace eosiosystem {
 
       check( bytes_out > 0, "must reserve a positive amount" );
 
-      _gstate.total_ram_bytes_reserved += uint64_t(bytes_out);
-      _gstate.total_ram_stake          += quant_after_fee.amount;
+      _gstate.get_mut().total_ram_bytes_reserved += uint64_t(bytes_out);
+      _gstate.get_mut().total_ram_stake          += quant_after_fee.amount;
 
       user_resources_table  userres( _self, receiver.value );
       auto res_itr = userres.find( receiver.value );
@@ -192,11 +192,11 @@ namespace eosiosystem {
 
       check( tokens_out.amount > 1, "token amount received from selling ram is too low" );
 
-      _gstate.total_ram_bytes_reserved -= static_cast<decltype(_gstate.total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
-      _gstate.total_ram_stake          -= tokens_out.amount;
+      _gstate.get_mut().total_ram_bytes_reserved -= static_cast<decltype(_gstate.get().total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
+      _gstate.get_mut().total_ram_stake          -= tokens_out.amount;
 
       //// this shouldn't happen, but just in case it does we should prevent it
-      check( _gstate.total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
+      check( _gstate.get().total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
 
       userres.modify( res_itr, account, [&]( auto& res ) {
           res.ram_bytes -= bytes;
@@ -465,7 +465,7 @@ namespace eosiosystem {
       check( unstake_cpu_quantity >= zero_asset, "must unstake a positive amount" );
       check( unstake_net_quantity >= zero_asset, "must unstake a positive amount" );
       check( unstake_cpu_quantity.amount + unstake_net_quantity.amount > 0, "must unstake a positive amount" );
-      check( _gstate.total_activated_stake >= min_activated_stake,
+      check( _gstate.get().total_activated_stake >= min_activated_stake,
              "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       changebw( from, receiver, -unstake_net_quantity, -unstake_cpu_quantity, false);
@@ -15,9 +15,11 @@ namespace eosiosystem {
     _voters(_self, _self.value),
     _producers(_self, _self.value),
     _producers2(_self, _self.value),
-    _global(_self, _self.value),
-    _global2(_self, _self.value),
-    _global3(_self, _self.value),
+    _prodcounters(_self, _self.value),
+    _pendingvotes(_self, _self.value),
+    _gstate(_self, _self.value, &get_default_parameters),
+    _gstate2(_self, _self.value),
+    _gstate3(_self, _self.value),
     _rammarket(_self, _self.value),
     _rexpool(_self, _self.value),
     _rexfunds(_self, _self.value),
@@ -25,9 +27,6 @@ namespace eosiosystem {
     _rexorders(_self, _self.value)
    {
       //print( "construct system\n" );
-      _gstate  = _global.exists() ? _global.get() : get_default_parameters();
-      _gstate2 = _global2.exists() ? _global2.get() : eosio_global_state2{};
-      _gstate3 = _global3.exists() ? _global3.get() : eosio_global_state3{};
    }
 
    eosio_global_state system_contract::get_default_parameters() {
@@ -57,19 +56,19 @@ namespace eosiosystem {
    }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, _self );
-      _global2.set( _gstate2, _self );
-      _global3.set( _gstate3, _self );
+      _gstate.save( _self );
+      _gstate2.save( _self );
+      _gstate3.save( _self );
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
       require_auth( _self );
 
-      check( _gstate.max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
+      check( _gstate.get().max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
       check( max_ram_size < 1024ll*1024*1024*1024*1024, "ram size is unrealistic" );
-      check( max_ram_size > _gstate.total_ram_bytes_reserved, "attempt to set max below reserved" );
+      check( max_ram_size > _gstate.get().total_ram_bytes_reserved, "attempt to set max below reserved" );
 
-      auto delta = int64_t(max_ram_size) - int64_t(_gstate.max_ram_size);
+      auto delta = int64_t(max_ram_size) - int64_t(_gstate.get().max_ram_size);
       auto itr = _rammarket.find(ramcore_symbol.raw());
 
       /**
@@ -79,17 +78,17 @@ namespace eosiosystem {
          m.base.balance.amount += delta;
       });
 
-      _gstate.max_ram_size = max_ram_size;
+      _gstate.get_mut().max_ram_size = max_ram_size;
    }
 
    void system_contract::update_ram_supply() {
       auto cbt = current_block_time();
 
-      if( cbt <= _gstate2.last_ram_increase ) return;
+      if( cbt <= _gstate2.get().last_ram_increase ) return;
 
       auto itr = _rammarket.find(ramcore_symbol.raw());
-      auto new_ram = (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
-      _gstate.max_ram_size += new_ram;
+      auto new_ram = (cbt.slot - _gstate2.get().last_ram_increase.slot)*_gstate2.get().new_ram_per_block;
+      _gstate.get_mut().max_ram_size += new_ram;
 
       /**
        *  Increase the amount of ram for sale based upon the change in max ram size.
@@ -97,7 +96,7 @@ namespace eosiosystem {
       _rammarket.modify( itr, same_payer, [&]( auto& m ) {
          m.base.balance.amount += new_ram;
       });
-      _gstate2.last_ram_increase = cbt;
+      _gstate2.get_mut().last_ram_increase = cbt;
    }
 
    /**
@@ -111,13 +110,13 @@ namespace eosiosystem {
       require_auth( _self );
 
       update_ram_supply();
-      _gstate2.new_ram_per_block = bytes_per_block;
+      _gstate2.get_mut().new_ram_per_block = bytes_per_block;
    }
 
    void system_contract::setparams( const eosio::blockchain_parameters& params ) {
       require_auth( _self );
-      (eosio::blockchain_parameters&)(_gstate) = params;
-      check( 3 <= _gstate.max_authority_depth, "max_authority_depth should be at least 3" );
+      (eosio::blockchain_parameters&)(_gstate.get_mut()) = params;
+      check( 3 <= _gstate.get().max_authority_depth, "max_authority_depth should be at least 3" );
       set_blockchain_parameters( params );
    }
 
@@ -288,11 +287,39 @@ namespace eosiosystem {
 
    void system_contract::updtrevision( uint8_t revision ) {
       require_auth( _self );
-      check( _gstate2.revision < 255, "can not increment revision" ); // prevent wrap around
-      check( revision == _gstate2.revision + 1, "can only increment revision by one" );
+      check( _gstate2.get().revision < 255, "can not increment revision" ); // prevent wrap around
+      check( revision == _gstate2.get().revision + 1, "can only increment revision by one" );
       check( revision <= 1, // set upper bound to greatest revision supported in the code
                     "specified revision is not yet supported by the code" );
-      _gstate2.revision = revision;
+      _gstate2.get_mut().revision = revision;
+   }
+
+   void system_contract::migrateprods( uint16_t max ) {
+      require_auth( _self );
+      check( max > 0, "max must be greater than 0" );
+
+      // producers without votepay state get it in their producers row from now on
+      if( !unified_producers() ) {
+         _gstate3.get_mut().unified_producers.emplace( true );
+      }
+
+      // migrated rows are erased, so every call resumes from the first remaining one
+      for( uint16_t i = 0; i < max; ++i ) {
+         auto prod2 = _producers2.begin();
+         if( prod2 == _producers2.end() ) {
+            break;
+         }
+         auto prod = _producers.find( prod2->owner.value );
+         if( prod != _producers.end() ) {
+            _producers.modify( prod, same_payer, [&]( auto& p ) {
+               producer_votepay votepay;
+               votepay.votepay_share             = prod2->votepay_share;
+               votepay.last_votepay_share_update = prod2->last_votepay_share_update;
+               p.votepay.emplace( votepay );
+            });
+         }
+         _producers2.erase( prod2 );
+      }
    }
 
    void system_contract::bidname( name bidder, name newname, asset bid ) {
@@ -443,10 +470,16 @@ namespace eosiosystem {
       check( system_token_supply.symbol == core, "specified core symbol does not exist (precision mismatch)" );
 
       check( system_token_supply.amount > 0, "system token supply must be greater than 0" );
+
+      // globals are only written back when modified, store the defaults so they exist from init on
+      _gstate.get_mut();
+      _gstate2.get_mut();
+      _gstate3.get_mut();
+
       _rammarket.emplace( _self, [&]( auto& m ) {
          m.supply.amount = 100000000000000ll;
          m.supply.symbol = ramcore_symbol;
-         m.base.balance.amount = int64_t(_gstate.free_ram());
+         m.base.balance.amount = int64_t(_gstate.get().free_ram());
          m.base.balance.symbol = ram_symbol;
          m.quote.balance.amount = system_token_supply.amount / 1000;
          m.quote.balance.symbol = core;
@@ -464,14 +497,14 @@ EOSIO_DISPATCH( eosiosystem::system_contract,
      (newaccount)(updateauth)(deleteauth)(linkauth)(unlinkauth)(canceldelay)(onerror)(setabi)
      // eosio.system.cpp
      (init)(setram)(setramrate)(setparams)(setpriv)(setalimits)(setacctram)(setacctnet)(setacctcpu)
-     (rmvproducer)(updtrevision)(bidname)(bidrefund)
+     (rmvproducer)(updtrevision)(migrateprods)(bidname)(bidrefund)
      // rex.cpp
      (deposit)(withdraw)(buyrex)(unstaketorex)(sellrex)(cnclrexorder)(rentcpu)(rentnet)(fundcpuloan)(fundnetloan)
-     (defcpuloan)(defnetloan)(updaterex)(consolidate)(mvtosavings)(mvfrsavings)(setrex)(rexexec)(closerex)
+     (defcpuloan)(defnetloan)(updaterex)(consolidate)(mvtosavings)(mvfrsavings)(setrex)(setrexmaint)(rexexec)(closerex)(setrexresult)
      // delegate_bandwidth.cpp
      (buyrambytes)(buyram)(sellram)(delegatebw)(undelegatebw)(refund)
      // voting.cpp
-     (regproducer)(unregprod)(voteproducer)(regproxy)
+     (regproducer)(unregprod)(voteproducer)(regproxy)(flushvotes)
      // producer_pay.cpp
      (onblock)(claimrewards)
 )
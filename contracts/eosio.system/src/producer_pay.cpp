@@ -25,46 +25,59 @@ namespace eosiosystem {
       name producer;
       _ds >> timestamp >> producer;
 
-      // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
-      // Although this field is deprecated, we will continue updating it for now until the last_block_num field
-      // is eventually completely removed, at which point this line can be removed.
-      _gstate2.last_block_num = timestamp;
+      /// budgeted REX maintenance, off until setrexmaint gives it a max_per_block
+      if ( rex_system_initialized() ) {
+         runrex_if_due( true );
+      }
 
       /** until activated stake crosses this threshold no new rewards are paid */
-      if( _gstate.total_activated_stake < min_activated_stake )
+      if( _gstate.get().total_activated_stake < min_activated_stake )
          return;
 
-      if( _gstate.last_pervote_bucket_fill == time_point() )  /// start the presses
-         _gstate.last_pervote_bucket_fill = current_time_point();
+      if( _gstate.get().last_pervote_bucket_fill == time_point() )  /// start the presses
+         _gstate.get_mut().last_pervote_bucket_fill = current_time_point();
 
 
       /**
        * At startup the initial producer may not be one that is registered / elected
        * and therefore there may be no producer object for them.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() ) {
-         _gstate.total_unpaid_blocks++;
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-               p.unpaid_blocks++;
+      auto counter = _prodcounters.find( producer.value );
+      if ( counter != _prodcounters.end() ) {
+         _gstate.get_mut().total_unpaid_blocks++;
+         _prodcounters.modify( counter, same_payer, [&](auto& c ) {
+               c.unpaid_blocks++;
+               c.last_block_time = timestamp;
+         });
+      } else if ( _producers.find( producer.value ) != _producers.end() ) {
+         _gstate.get_mut().total_unpaid_blocks++;
+         _prodcounters.emplace( _self, [&](auto& c ) {
+               c.owner           = producer;
+               c.unpaid_blocks   = 1;
+               c.last_block_time = timestamp;
          });
       }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
-      if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
+      if( timestamp.slot - _gstate.get().last_producer_schedule_update.slot > 120 ) {
+         // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
+         // Until the deprecated field is removed it is kept roughly current here, once a minute,
+         // rather than writing global2 on every block.
+         _gstate2.get_mut().last_block_num = timestamp;
+
          update_elected_producers( timestamp );
 
-         if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
+         if( (timestamp.slot - _gstate.get().last_name_close.slot) > blocks_per_day ) {
             name_bid_table bids(_self, _self.value);
             auto idx = bids.get_index<"highbid"_n>();
             auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
             if( highest != idx.end() &&
                 highest->high_bid > 0 &&
                 (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day) &&
-                _gstate.thresh_activated_stake_time > time_point() &&
-                (current_time_point() - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
+                _gstate.get().thresh_activated_stake_time > time_point() &&
+                (current_time_point() - _gstate.get().thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
             ) {
-               _gstate.last_name_close = timestamp;
+               _gstate.get_mut().last_name_close = timestamp;
                channel_namebid_to_rex( highest->high_bid );
                idx.modify( highest, same_payer, [&]( auto& b ){
                   b.high_bid = -b.high_bid;
@@ -81,17 +94,29 @@ namespace eosiosystem {
       const auto& prod = _producers.get( owner.value );
       check( prod.active(), "producer does not have an active key" );
 
-      check( _gstate.total_activated_stake >= min_activated_stake,
+      check( _gstate.get().total_activated_stake >= min_activated_stake,
                     "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       const auto ct = current_time_point();
 
       check( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
 
+      auto pv = _pendingvotes.find( owner.value );
+      if( pv != _pendingvotes.end() ) {
+         double delta_change_rate         = 0.0;
+         double total_inactive_vpay_share = 0.0;
+         fold_pending_votes( pv, prod, ct, delta_change_rate, total_inactive_vpay_share );
+         update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      }
+
+      /// blocks counted in producer_info before the prodcounter table existed are paid as well
+      auto counter = _prodcounters.find( owner.value );
+      const uint32_t unpaid_blocks = prod.unpaid_blocks + ( counter != _prodcounters.end() ? counter->unpaid_blocks : 0 );
+
       const asset token_supply   = eosio::token::get_supply(token_account, core_symbol().code() );
-      const auto usecs_since_last_fill = (ct - _gstate.last_pervote_bucket_fill).count();
+      const auto usecs_since_last_fill = (ct - _gstate.get().last_pervote_bucket_fill).count();
 
-      if( usecs_since_last_fill > 0 && _gstate.last_pervote_bucket_fill > time_point() ) {
+      if( usecs_since_last_fill > 0 && _gstate.get().last_pervote_bucket_fill > time_point() ) {
          auto new_tokens = static_cast<int64_t>( (continuous_rate * double(token_supply.amount) * double(usecs_since_last_fill)) / double(useconds_per_year) );
 
          auto to_producers     = new_tokens / 5;
@@ -119,12 +144,13 @@ namespace eosiosystem {
             { _self, vpay_account, asset(to_per_vote_pay, core_symbol()), "fund per-vote bucket" }
          );
 
-         _gstate.pervote_bucket          += to_per_vote_pay;
-         _gstate.perblock_bucket         += to_per_block_pay;
-         _gstate.last_pervote_bucket_fill = ct;
+         _gstate.get_mut().pervote_bucket          += to_per_vote_pay;
+         _gstate.get_mut().perblock_bucket         += to_per_block_pay;
+         _gstate.get_mut().last_pervote_bucket_fill = ct;
       }
 
-      auto prod2 = _producers2.find( owner.value );
+      auto prod2 = prod.votepay.has_value() ? _producers2.end() : _producers2.find( owner.value );
+      const bool unified = prod.votepay.has_value() || ( prod2 == _producers2.end() && unified_producers() );
 
       /// New metric to be used in pervote pay calculation. Instead of vote weight ratio, we combine vote weight and
       /// time duration the vote weight has been held into one metric.
@@ -132,9 +158,14 @@ namespace eosiosystem {
 
       bool crossed_threshold       = (last_claim_plus_3days <= ct);
       bool updated_after_threshold = true;
-      if ( prod2 != _producers2.end() ) {
+      producer_votepay votepay;
+      votepay.last_votepay_share_update = ct;
+      if ( prod.votepay.has_value() ) {
+         votepay = prod.votepay.value();
+         updated_after_threshold = (last_claim_plus_3days <= votepay.last_votepay_share_update);
+      } else if ( prod2 != _producers2.end() ) {
          updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-      } else {
+      } else if ( !unified ) {
          prod2 = _producers2.emplace( owner, [&]( producer_info2& info  ) {
             info.owner                     = owner;
             info.last_votepay_share_update = ct;
@@ -147,27 +178,26 @@ namespace eosiosystem {
       // In fact it is desired behavior because the producers votes need to be counted in the global total_producer_votepay_share for the first time.
 
       int64_t producer_per_block_pay = 0;
-      if( _gstate.total_unpaid_blocks > 0 ) {
-         producer_per_block_pay = (_gstate.perblock_bucket * prod.unpaid_blocks) / _gstate.total_unpaid_blocks;
+      if( _gstate.get().total_unpaid_blocks > 0 ) {
+         producer_per_block_pay = (_gstate.get().perblock_bucket * unpaid_blocks) / _gstate.get().total_unpaid_blocks;
       }
 
-      double new_votepay_share = update_producer_votepay_share( prod2,
-                                    ct,
-                                    updated_after_threshold ? 0.0 : prod.total_votes,
-                                    true // reset votepay_share to zero after updating
-                                 );
+      const double shares_rate = updated_after_threshold ? 0.0 : prod.total_votes;
+      // reset votepay_share to zero after updating, the unified row is written back below
+      double new_votepay_share = unified ? accrue_votepay_share( votepay, ct, shares_rate, true )
+                                         : update_producer_votepay_share( prod2, ct, shares_rate, true );
 
       int64_t producer_per_vote_pay = 0;
-      if( _gstate2.revision > 0 ) {
+      if( _gstate2.get().revision > 0 ) {
          double total_votepay_share = update_total_votepay_share( ct );
          if( total_votepay_share > 0 && !crossed_threshold ) {
-            producer_per_vote_pay = int64_t((new_votepay_share * _gstate.pervote_bucket) / total_votepay_share);
-            if( producer_per_vote_pay > _gstate.pervote_bucket )
-               producer_per_vote_pay = _gstate.pervote_bucket;
+            producer_per_vote_pay = int64_t((new_votepay_share * _gstate.get().pervote_bucket) / total_votepay_share);
+            if( producer_per_vote_pay > _gstate.get().pervote_bucket )
+               producer_per_vote_pay = _gstate.get().pervote_bucket;
          }
       } else {
-         if( _gstate.total_producer_vote_weight > 0 ) {
-            producer_per_vote_pay = int64_t((_gstate.pervote_bucket * prod.total_votes) / _gstate.total_producer_vote_weight);
+         if( _gstate.get().total_producer_vote_weight > 0 ) {
+            producer_per_vote_pay = int64_t((_gstate.get().pervote_bucket * prod.total_votes) / _gstate.get().total_producer_vote_weight);
          }
       }
 
@@ -175,16 +205,23 @@ namespace eosiosystem {
          producer_per_vote_pay = 0;
       }
 
-      _gstate.pervote_bucket      -= producer_per_vote_pay;
-      _gstate.perblock_bucket     -= producer_per_block_pay;
-      _gstate.total_unpaid_blocks -= prod.unpaid_blocks;
+      _gstate.get_mut().pervote_bucket      -= producer_per_vote_pay;
+      _gstate.get_mut().perblock_bucket     -= producer_per_block_pay;
+      _gstate.get_mut().total_unpaid_blocks -= unpaid_blocks;
 
       update_total_votepay_share( ct, -new_votepay_share, (updated_after_threshold ? prod.total_votes : 0.0) );
 
       _producers.modify( prod, same_payer, [&](auto& p) {
          p.last_claim_time = ct;
          p.unpaid_blocks   = 0;
+         if( unified )
+            p.votepay.emplace( votepay );
       });
+      if( counter != _prodcounters.end() ) {
+         _prodcounters.modify( counter, same_payer, [&](auto& c) {
+            c.unpaid_blocks = 0;
+         });
+      }
 
       if( producer_per_block_pay > 0 ) {
          INLINE_ACTION_SENDER(eosio::token, transfer)(
@@ -60,11 +60,13 @@ namespace eosiosystem {
       transfer_from_fund( from, amount );
       const asset rex_received    = add_to_rex_pool( amount );
       const asset delta_rex_stake = add_to_rex_balance( from, amount, rex_received );
-      runrex(2);
+      runrex_if_due();
       update_rex_account( from, asset( 0, core_symbol() ), delta_rex_stake );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
-      rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
-      buyrex_act.send( rex_received );
+      if ( !record_rex_result( from, "buyrex"_n, rex_received ) ) {
+         rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
+         buyrex_act.send( rex_received );
+      }
    }
 
    /**
@@ -108,11 +110,13 @@ namespace eosiosystem {
       }
       const asset rex_received = add_to_rex_pool( payment );
       add_to_rex_balance( owner, payment, rex_received );
-      runrex(2);
+      runrex_if_due();
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ), true );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
-      rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
-      buyrex_act.send( rex_received );
+      if ( !record_rex_result( owner, "unstaketorex"_n, rex_received ) ) {
+         rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
+         buyrex_act.send( rex_received );
+      }
    }
 
    /**
@@ -125,7 +129,7 @@ namespace eosiosystem {
    {
       require_auth( from );
 
-      runrex(2);
+      runrex_if_due();
 
       auto bitr = _rexbalance.require_find( from.value, "user must first buyrex" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol,
@@ -161,11 +165,14 @@ namespace eosiosystem {
                order.rex_requested.amount += rex.amount;
             });
          }
+         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rp ) {
+            rp.maintenance_mut().open_orders = true;
+         });
          pending_sell_order.amount = oitr->rex_requested.amount;
       }
       check( pending_sell_order.amount <= bitr->matured_rex, "insufficient funds for current and scheduled orders" );
       // dummy action added so that sell order proceeds show up in action trace
-      if ( current_order.success ) {
+      if ( current_order.success && !record_rex_result( from, "sellrex"_n, current_order.proceeds ) ) {
          rex_results::sellresult_action sellrex_act( rex_account, std::vector<eosio::permission_level>{ } );
          sellrex_act.send( current_order.proceeds );
       }
@@ -202,7 +209,7 @@ namespace eosiosystem {
       require_auth( from );
 
       rex_cpu_loan_table cpu_loans( _self, _self.value );
-      int64_t rented_tokens = rent_rex( cpu_loans, from, receiver, loan_payment, loan_fund );
+      int64_t rented_tokens = rent_rex( cpu_loans, "cpuloan"_n, from, receiver, loan_payment, loan_fund );
       update_resource_limits( from, receiver, 0, rented_tokens );
    }
 
@@ -223,7 +230,7 @@ namespace eosiosystem {
       require_auth( from );
 
       rex_net_loan_table net_loans( _self, _self.value );
-      int64_t rented_tokens = rent_rex( net_loans, from, receiver, loan_payment, loan_fund );
+      int64_t rented_tokens = rent_rex( net_loans, "netloan"_n, from, receiver, loan_payment, loan_fund );
       update_resource_limits( from, receiver, rented_tokens, 0 );
    }
 
@@ -298,7 +305,7 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_due();
 
       auto itr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       const asset init_stake = itr->vote_stake;
@@ -351,6 +358,24 @@ namespace eosiosystem {
       runrex( max );
    }
 
+   /**
+    * @brief Sets REX maintenance budgets
+    *
+    * @param max_per_action - number of each of CPU loans, NET loans, and sell orders processed by a user REX action
+    * @param max_per_block - number of each of CPU loans, NET loans, and sell orders processed by onblock
+    */
+   void system_contract::setrexmaint( uint16_t max_per_action, uint16_t max_per_block )
+   {
+      require_auth( _self );
+
+      check( rex_system_initialized(), "rex system is not initialized" );
+      _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& pool ) {
+         auto& m = pool.maintenance_mut();
+         m.max_per_action = max_per_action;
+         m.max_per_block  = max_per_block;
+      });
+   }
+
    /**
     * @brief Consolidates REX maturity buckets into one bucket that cannot be sold before
     * 4 days
@@ -361,7 +386,7 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_due();
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       asset rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
@@ -378,24 +403,23 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_due();
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
-      const asset   rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
-      const int64_t rex_in_savings    = read_rex_savings( bitr );
-      check( rex.amount + rex_in_sell_order.amount + rex_in_savings <= bitr->rex_balance.amount,
-             "insufficient REX balance" );
+      const asset rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
       process_rex_maturities( bitr );
+      check( rex.amount + rex_in_sell_order.amount + bitr->maturity_slots.value().savings <= bitr->rex_balance.amount,
+             "insufficient REX balance" );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         auto& ms = rb.maturity_slots.value();
          int64_t moved_rex = 0;
-         while ( !rb.rex_maturities.empty() && moved_rex < rex.amount) {
-            const int64_t drex = std::min( rex.amount - moved_rex, rb.rex_maturities.back().second );
-            rb.rex_maturities.back().second -= drex;
-            moved_rex                       += drex;
-            if ( rb.rex_maturities.back().second == 0 ) {
-               rb.rex_maturities.pop_back();
-            }
+         /// latest maturities first
+         for ( uint32_t d = ms.last_day + num_of_maturity_buckets; d > ms.last_day && moved_rex < rex.amount; --d ) {
+            int64_t& bucket    = ms.days[d % num_of_maturity_buckets];
+            const int64_t drex = std::min( rex.amount - moved_rex, bucket );
+            bucket            -= drex;
+            moved_rex         += drex;
          }
          if ( moved_rex < rex.amount ) {
             const int64_t drex = rex.amount - moved_rex;
@@ -404,8 +428,8 @@ namespace eosiosystem {
             check( rex_in_sell_order.amount <= rb.matured_rex, "logic error in mvtosavings" );
          }
          check( moved_rex == rex.amount, "programmer error in mvtosavings" );
+         ms.savings += rex.amount;
       });
-      put_rex_savings( bitr, rex_in_savings + rex.amount );
    }
 
    /**
@@ -418,22 +442,17 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex_if_due();
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
-      const int64_t rex_in_savings = read_rex_savings( bitr );
-      check( rex.amount <= rex_in_savings, "insufficient REX in savings" );
       process_rex_maturities( bitr );
+      check( rex.amount <= bitr->maturity_slots.value().savings, "insufficient REX in savings" );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex.amount;
-         } else {
-            rb.rex_maturities.emplace_back( maturity, rex.amount );
-         }
+         auto& ms = rb.maturity_slots.value();
+         ms.newest() += rex.amount;
+         ms.savings  -= rex.amount;
       });
-      put_rex_savings( bitr, rex_in_savings - rex.amount );
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
    }
 
@@ -447,7 +466,7 @@ namespace eosiosystem {
       require_auth( owner );
 
       if ( rex_system_initialized() )
-         runrex(2);
+         runrex_if_due();
 
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
 
@@ -477,6 +496,38 @@ namespace eosiosystem {
             _rexbalance.erase( rex_itr );
          }
       }
+
+      /// delete result row only once the account is fully closed, a partial close keeps the owner's choice
+      if ( _rexfunds.find( owner.value ) == _rexfunds.end() ) {
+         rex_result_table results( _self, _self.value );
+         auto res_itr = results.find( owner.value );
+         if ( res_itr != results.end() ) {
+            results.erase( res_itr );
+         }
+      }
+   }
+
+   /**
+    * @brief Chooses how results of owner REX actions are reported
+    *
+    * @param owner - owner account name
+    * @param use_row - if true, results are written to owner rexresult row, otherwise they are
+    * sent as rex.results inline actions
+    */
+   void system_contract::setrexresult( const name& owner, bool use_row )
+   {
+      require_auth( owner );
+
+      rex_result_table results( _self, _self.value );
+      auto itr = results.find( owner.value );
+      if ( use_row && itr == results.end() ) {
+         results.emplace( owner, [&]( auto& r ) {
+            r.owner  = owner;
+            r.result = asset( 0, core_symbol() );
+         });
+      } else if ( !use_row && itr != results.end() ) {
+         results.erase( itr );
+      }
    }
 
    /**
@@ -611,9 +662,11 @@ namespace eosiosystem {
          // add payment to total_unlent
          rt.total_unlent.amount  += payment.amount;
          rt.total_lendable.amount = rt.total_unlent.amount + rt.total_lent.amount;
-         // increment loan_num if a new loan is being created
+         // increment loan_num if a new loan is being created, it expires in 30 days
          if ( new_loan ) {
             rt.loan_num++;
+            auto& m = rt.maintenance_mut();
+            m.next_expiration = std::min( m.next_expiration, time_point_sec( current_time_point() + eosio::days(30) ) );
          }
       });
    }
@@ -641,12 +694,15 @@ namespace eosiosystem {
 
    /**
     * @brief Updates the fields of an existing loan that is being renewed
+    *
+    * A renewed loan becomes version 1, caller schedules its new expiration.
     */
    template <typename Index, typename Iterator>
    int64_t system_contract::update_renewed_loan( Index& idx, const Iterator& itr, int64_t rented_tokens )
    {
       int64_t delta_stake = rented_tokens - itr->total_staked.amount;
       idx.modify ( itr, same_payer, [&]( auto& loan ) {
+         loan.version             = 1;
          loan.total_staked.amount = rented_tokens;
          loan.expiration         += eosio::days(30);
          loan.balance.amount     -= loan.payment.amount;
@@ -654,6 +710,62 @@ namespace eosiosystem {
       return delta_stake;
    }
 
+   /**
+    * @brief Adds a version 1 loan to the expiration schedule of its table
+    *
+    * @param table_name - name of the loan table, cpuloan or netloan
+    * @param loan - the loan
+    */
+   void system_contract::schedule_rex_loan( const name& table_name, const rex_loan& loan )
+   {
+      rex_loan_expiry_table expiries( _self, table_name.value );
+      uint64_t slot = ( uint64_t( time_point_sec( loan.expiration ).utc_seconds ) << 32 ) | ( loan.loan_num & 0xFFFFFFFF );
+      while ( expiries.find( slot ) != expiries.end() ) { /// loan_num only wraps after 2^32 loans
+         ++slot;
+      }
+      expiries.emplace( _self, [&]( auto& e ) {
+         e.slot     = slot;
+         e.loan_num = loan.loan_num;
+      });
+   }
+
+   /**
+    * @brief Returns REX maintenance summary, defaults mark maintenance as due if runrex never recorded one
+    */
+   rex_maintenance system_contract::get_rex_maintenance()const
+   {
+      const auto& pool = *_rexpool.begin();
+      return pool.maintenance.has_value() ? pool.maintenance.value() : rex_maintenance{};
+   }
+
+   /**
+    * @brief Checks if a loan may have expired, a sellrex order may be fillable or namebid proceeds
+    * are waiting to be channeled to REX pool
+    */
+   bool system_contract::rex_maintenance_due()const
+   {
+      const rex_maintenance m = get_rex_maintenance();
+      return _rexpool.begin()->namebid_proceeds.amount > 0
+             || m.open_orders
+             || m.next_expiration <= current_time_point_sec();
+   }
+
+   /**
+    * @brief Runs runrex within the budget of a user REX action or of onblock, only if maintenance is due
+    *
+    * @param onblock - use the per-block budget instead of the per-action one
+    */
+   void system_contract::runrex_if_due( bool onblock )
+   {
+      check( rex_system_initialized(), "rex system not initialized yet" );
+
+      const rex_maintenance m = get_rex_maintenance();
+      const uint16_t max = onblock ? m.max_per_block : m.max_per_action;
+      if ( max > 0 && rex_maintenance_due() ) {
+         runrex( max );
+      }
+   }
+
    /**
     * @brief Performs maintenance operations on expired NET and CPU loans and sellrex oders
     *
@@ -703,73 +815,86 @@ namespace eosiosystem {
          });
       }
 
-      /// process cpu loans
-      {
-         rex_cpu_loan_table cpu_loans( _self, _self.value );
-         auto cpu_idx = cpu_loans.get_index<"byexpr"_n>();
-         for ( uint16_t i = 0; i < max; ++i ) {
-            auto itr = cpu_idx.begin();
-            if ( itr == cpu_idx.end() || itr->expiration > current_time_point() ) break;
+      rex_cpu_loan_table cpu_loans( _self, _self.value );
+      rex_net_loan_table net_loans( _self, _self.value );
+
+      /// expire loans of a table oldest first, version 0 loans through byexpr and version 1 loans through loanexpiry
+      auto process_expired_loans = [&]( auto& loans, const name& table_name, bool cpu ) {
+         auto update_limits = [&]( const rex_loan& loan, int64_t delta_stake ) {
+            if ( delta_stake != 0 )
+               update_resource_limits( loan.from, loan.receiver, cpu ? 0 : delta_stake, cpu ? delta_stake : 0 );
+         };
 
-            auto result = process_expired_loan( cpu_idx, itr );
-            if ( result.second != 0 )
-               update_resource_limits( itr->from, itr->receiver, 0, result.second );
+         uint16_t i = 0;
+         auto idx = loans.template get_index<"byexpr"_n>();
+         for ( ; i < max; ++i ) {
+            auto itr = idx.begin();
+            if ( itr == idx.end() || itr->version != 0 || itr->expiration > current_time_point() ) break;
+
+            auto result = process_expired_loan( idx, itr );
+            update_limits( *itr, result.second );
 
             if ( result.first )
-               cpu_idx.erase( itr );
+               idx.erase( itr );
+            else
+               schedule_rex_loan( table_name, *itr );
          }
-      }
 
-      /// process net loans
-      {
-         rex_net_loan_table net_loans( _self, _self.value );
-         auto net_idx = net_loans.get_index<"byexpr"_n>();
-         for ( uint16_t i = 0; i < max; ++i ) {
-            auto itr = net_idx.begin();
-            if ( itr == net_idx.end() || itr->expiration > current_time_point() ) break;
+         rex_loan_expiry_table expiries( _self, table_name.value );
+         for ( ; i < max; ++i ) {
+            auto eitr = expiries.begin();
+            if ( eitr == expiries.end() || eitr->expiration() > current_time_point_sec() ) break;
+            auto itr = loans.require_find( eitr->loan_num, "programmer error, scheduled loan not found" );
+            if ( itr->expiration > current_time_point() ) break;
+            expiries.erase( eitr );
 
-            auto result = process_expired_loan( net_idx, itr );
-            if ( result.second != 0 )
-               update_resource_limits( itr->from, itr->receiver, result.second, 0 );
+            auto result = process_expired_loan( loans, itr );
+            update_limits( *itr, result.second );
 
             if ( result.first )
-               net_idx.erase( itr );
+               loans.erase( itr );
+            else
+               schedule_rex_loan( table_name, *itr );
          }
-      }
+      };
+
+      process_expired_loans( cpu_loans, "cpuloan"_n, true );
+      process_expired_loans( net_loans, "netloan"_n, false );
 
       /// process sellrex orders
-      if ( _rexorders.begin() != _rexorders.end() ) {
-         auto idx  = _rexorders.get_index<"bytime"_n>();
-         auto oitr = idx.begin();
-         for ( uint16_t i = 0; i < max; ++i ) {
-            if ( oitr == idx.end() || !oitr->is_open ) break;
-            auto next = oitr;
-            ++next;
-            auto bitr = _rexbalance.find( oitr->owner.value );
-            if ( bitr != _rexbalance.end() ) { // should always be true
-               auto result = fill_rex_order( bitr, oitr->rex_requested );
-               if ( result.success ) {
-                  const name order_owner = oitr->owner;
-                  idx.modify( oitr, same_payer, [&]( auto& order ) {
-                     order.proceeds.amount     = result.proceeds.amount;
-                     order.stake_change.amount = result.stake_change.amount;
-                     order.close();
-                  });
-                  /// send dummy action to show owner and proceeds of filled sellrex order
-                  rex_results::orderresult_action order_act( rex_account, std::vector<eosio::permission_level>{ } );
-                  order_act.send( order_owner, result.proceeds );
-               }
-            }
-            oitr = next;
+      fill_rex_orders( max );
+
+      /// record what is left so that REX actions skip runrex until it is due again
+      auto earliest_expiration = [&]( const auto& loans, const name& table_name ) {
+         time_point_sec earliest = time_point_sec::maximum();
+         auto idx = loans.template get_index<"byexpr"_n>();
+         auto itr = idx.begin();
+         if ( itr != idx.end() && itr->version == 0 ) {
+            earliest = time_point_sec( itr->expiration );
          }
-      }
-
+         rex_loan_expiry_table expiries( _self, table_name.value );
+         auto eitr = expiries.begin();
+         if ( eitr != expiries.end() ) {
+            earliest = std::min( earliest, eitr->expiration() );
+         }
+         return earliest;
+      };
+      const time_point_sec next_expiration = std::min( earliest_expiration( cpu_loans, "cpuloan"_n ),
+                                                      earliest_expiration( net_loans, "netloan"_n ) );
+      const bool open_orders = _rexorders.begin() != _rexorders.end()
+                               && _rexorders.get_index<"bytime"_n>().begin()->is_open;
+      _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
+         auto& m = rt.maintenance_mut();
+         m.next_expiration = next_expiration;
+         m.open_orders     = open_orders;
+      });
    }
 
    template <typename T>
-   int64_t system_contract::rent_rex( T& table, const name& from, const name& receiver, const asset& payment, const asset& fund )
+   int64_t system_contract::rent_rex( T& table, const name& table_name, const name& from, const name& receiver,
+                                      const asset& payment, const asset& fund )
    {
-      runrex(2);
+      runrex_if_due();
 
       check( rex_loans_available(), "rex loans are currently not available" );
       check( payment.symbol == core_symbol() && fund.symbol == core_symbol(), "must use core token" );
@@ -783,7 +908,8 @@ namespace eosiosystem {
       check( payment.amount < rented_tokens, "loan price does not favor renting" );
       add_loan_to_rex_pool( payment, rented_tokens, true );
 
-      table.emplace( from, [&]( auto& c ) {
+      auto itr = table.emplace( from, [&]( auto& c ) {
+         c.version      = 1;
          c.from         = from;
          c.receiver     = receiver;
          c.payment      = payment;
@@ -792,9 +918,12 @@ namespace eosiosystem {
          c.expiration   = current_time_point() + eosio::days(30);
          c.loan_num     = pool->loan_num;
       });
+      schedule_rex_loan( table_name, *itr );
 
-      rex_results::rentresult_action rentresult_act{ rex_account, std::vector<eosio::permission_level>{ } };
-      rentresult_act.send( asset{ rented_tokens, core_symbol() } );
+      if ( !record_rex_result( from, table_name == "cpuloan"_n ? "rentcpu"_n : "rentnet"_n, asset{ rented_tokens, core_symbol() } ) ) {
+         rex_results::rentresult_action rentresult_act{ rex_account, std::vector<eosio::permission_level>{ } };
+         rentresult_act.send( asset{ rented_tokens, core_symbol() } );
+      }
       return rented_tokens;
    }
 
@@ -817,37 +946,115 @@ namespace eosiosystem {
    rex_order_outcome system_contract::fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex )
    {
       auto rexitr = _rexpool.begin();
-      const int64_t S0 = rexitr->total_lendable.amount;
-      const int64_t R0 = rexitr->total_rex.amount;
-      const int64_t p  = (uint128_t(rex.amount) * S0) / R0;
-      const int64_t R1 = R0 - rex.amount;
-      const int64_t S1 = S0 - p;
-      asset proceeds( p, core_symbol() );
-      asset stake_change( 0, core_symbol() );
-      bool  success = false;
-
-      const int64_t unlent_lower_bound = ( uint128_t(2) * rexitr->total_lent.amount ) / 10;
-      const int64_t available_unlent   = rexitr->total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
-      if ( proceeds.amount <= available_unlent ) {
-         const int64_t init_vote_stake_amount = bitr->vote_stake.amount;
-         const int64_t current_stake_value    = ( uint128_t(bitr->rex_balance.amount) * S0 ) / R0;
+      int64_t S      = rexitr->total_lendable.amount;
+      int64_t R      = rexitr->total_rex.amount;
+      int64_t unlent = rexitr->total_unlent.amount;
+      const auto outcome = fill_rex_sale( bitr, rex.amount, rexitr->total_lent.amount, S, R, unlent );
+      if ( outcome.success ) {
          _rexpool.modify( rexitr, same_payer, [&]( auto& rt ) {
-            rt.total_rex.amount      = R1;
-            rt.total_lendable.amount = S1;
-            rt.total_unlent.amount   = rt.total_lendable.amount - rt.total_lent.amount;
+            rt.total_rex.amount      = R;
+            rt.total_lendable.amount = S;
+            rt.total_unlent.amount   = unlent;
          });
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rb.vote_stake.amount   = current_stake_value - proceeds.amount;
-            rb.rex_balance.amount -= rex.amount;
-            rb.matured_rex        -= rex.amount;
-         });
-         stake_change.amount = bitr->vote_stake.amount - init_vote_stake_amount;
-         success = true;
-      } else {
-         proceeds.amount = 0;
       }
+      return outcome;
+   }
+
+   /**
+    * @brief Sells REX of an owner against REX pool totals held by the caller
+    *
+    * Prices rex at the current S/R ratio and sells it if the proceeds leave at least 20% of
+    * lent tokens unlent. In that case the owner rex_balance and vote_stake are updated, and
+    * S, R and unlent are moved past the sale. Writing them back to REX pool is left to the caller.
+    *
+    * @param bitr - iterator pointing to rex_balance database record
+    * @param rex - amount of rex to be sold
+    * @param lent - REX pool total_lent
+    * @param S - REX pool total_lendable, updated on success
+    * @param R - REX pool total_rex, updated on success
+    * @param unlent - REX pool total_unlent, updated on success
+    *
+    * @return rex_order_outcome - a struct containing success flag, order proceeds, and resultant
+    * vote stake change
+    */
+   rex_order_outcome system_contract::fill_rex_sale( const rex_balance_table::const_iterator& bitr, int64_t rex, int64_t lent,
+                                                     int64_t& S, int64_t& R, int64_t& unlent )
+   {
+      const int64_t p                  = ( uint128_t(rex) * S ) / R;
+      const int64_t unlent_lower_bound = ( uint128_t(2) * lent ) / 10;
+      if ( unlent - unlent_lower_bound < p ) { // available unlent <= 0 is possible
+         return { false, asset( 0, core_symbol() ), asset( 0, core_symbol() ) };
+      }
+
+      const int64_t init_vote_stake_amount = bitr->vote_stake.amount;
+      const int64_t current_stake_value    = ( uint128_t(bitr->rex_balance.amount) * S ) / R;
+      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         rb.vote_stake.amount   = current_stake_value - p;
+         rb.rex_balance.amount -= rex;
+         rb.matured_rex        -= rex;
+      });
+      S     -= p;
+      R     -= rex;
+      unlent = S - lent;
 
-      return { success, proceeds, stake_change };
+      return { true, asset( p, core_symbol() ), asset( bitr->vote_stake.amount - init_vote_stake_amount, core_symbol() ) };
+   }
+
+   /**
+    * @brief Fills queued sellrex orders as one batch
+    *
+    * Walks open orders oldest first and fills every order that REX pool unlent balance can still
+    * cover, exactly as consecutive fill_rex_order calls would, but keeps pool totals in locals and
+    * writes them once. Owners and proceeds of filled orders are reported in a single batchresult
+    * action.
+    *
+    * @param max - maximum number of open orders to be examined
+    */
+   void system_contract::fill_rex_orders( uint16_t max )
+   {
+      if ( _rexorders.begin() == _rexorders.end() ) {
+         return;
+      }
+
+      const auto& pool = _rexpool.begin();
+      const int64_t lent = pool->total_lent.amount;
+      int64_t S      = pool->total_lendable.amount;
+      int64_t R      = pool->total_rex.amount;
+      int64_t unlent = pool->total_unlent.amount;
+
+      std::vector<std::pair<name, asset>> filled_orders;
+      auto idx  = _rexorders.get_index<"bytime"_n>();
+      auto oitr = idx.begin();
+      for ( uint16_t i = 0; i < max; ++i ) {
+         if ( oitr == idx.end() || !oitr->is_open ) break;
+         auto next = oitr;
+         ++next;
+         auto bitr = _rexbalance.find( oitr->owner.value );
+         if ( bitr != _rexbalance.end() ) { // should always be true
+            const auto outcome = fill_rex_sale( bitr, oitr->rex_requested.amount, lent, S, R, unlent );
+            if ( outcome.success ) {
+               const name order_owner = oitr->owner;
+               idx.modify( oitr, same_payer, [&]( auto& order ) {
+                  order.proceeds     = outcome.proceeds;
+                  order.stake_change = outcome.stake_change;
+                  order.close();
+               });
+               filled_orders.emplace_back( order_owner, outcome.proceeds );
+            }
+         }
+         oitr = next;
+      }
+
+      if ( !filled_orders.empty() ) {
+         _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
+            rt.total_rex.amount      = R;
+            rt.total_lendable.amount = S;
+            rt.total_unlent.amount   = unlent;
+         });
+         /// send dummy action to show owners and proceeds of filled sellrex orders
+         rex_results::batchresult_action batch_act( rex_account, std::vector<eosio::permission_level>{ } );
+         batch_act.send( filled_orders );
+      }
    }
 
    template <typename T>
@@ -877,6 +1084,30 @@ namespace eosiosystem {
       transfer_to_fund( from, amount );
    }
 
+   /**
+    * @brief Writes result of a REX action to owner rexresult row if owner has one
+    *
+    * @param owner - owner account name
+    * @param act - action that produced the result
+    * @param result - REX bought, sellrex proceeds or tokens rented
+    *
+    * @return bool - false if owner has no row and result must be sent as an inline action
+    */
+   bool system_contract::record_rex_result( const name& owner, const name& act, const asset& result )
+   {
+      rex_result_table results( _self, _self.value );
+      auto itr = results.find( owner.value );
+      if ( itr == results.end() ) {
+         return false;
+      }
+      results.modify( itr, same_payer, [&]( auto& r ) {
+         r.action = act;
+         r.result = result;
+         r.sequence++;
+      });
+      return true;
+   }
+
    /**
     * @brief Transfers tokens from owner REX fund
     *
@@ -995,18 +1226,51 @@ namespace eosiosystem {
    }
 
    /**
-    * @brief Calculates maturity time of purchased REX tokens which is 4 days from end
-    * of the day UTC
+    * @brief Returns current day number, REX bought today matures at the start of day
+    * get_rex_day() + num_of_maturity_buckets UTC
     *
-    * @return time_point_sec
+    * @return uint32_t
     */
-   time_point_sec system_contract::get_rex_maturity()
+   uint32_t system_contract::get_rex_day()
    {
-      const uint32_t num_of_maturity_buckets = 5;
-      static const uint32_t now = current_time_point_sec().utc_seconds;
-      static const uint32_t r   = now % seconds_per_day;
-      static const time_point_sec rms{ now - r + num_of_maturity_buckets * seconds_per_day };
-      return rms;
+      static const uint32_t today = current_time_point_sec().utc_seconds / seconds_per_day;
+      return today;
+   }
+
+   /**
+    * @brief Returns maturity buckets of a REX balance, converting a version 0 balance first
+    *
+    * Version 0 balances keep maturity buckets in a deque. They are moved to fixed day slots on
+    * first touch, buckets that have already matured are added to matured_rex.
+    *
+    * @param rb - rex_balance object being modified
+    *
+    * @return rex_maturity_slots& - maturity buckets of rb
+    */
+   rex_maturity_slots& system_contract::get_rex_maturity_slots( rex_balance& rb )
+   {
+      if ( rb.maturity_slots.has_value() ) {
+         return rb.maturity_slots.value();
+      }
+      const uint32_t today = get_rex_day();
+      auto& ms    = rb.maturity_slots.emplace();
+      ms.last_day = today;
+      for ( const auto& bucket : rb.rex_maturities ) {
+         if ( bucket.first == time_point_sec::maximum() ) {
+            ms.savings += bucket.second;
+         } else {
+            const uint32_t day = ( bucket.first.utc_seconds + seconds_per_day - 1 ) / seconds_per_day;
+            if ( day <= today ) {
+               rb.matured_rex += bucket.second;
+            } else {
+               check( day <= today + num_of_maturity_buckets, "programmer error, rex maturity out of range" );
+               ms.days[day % num_of_maturity_buckets] += bucket.second;
+            }
+         }
+      }
+      rb.rex_maturities.clear();
+      rb.version = 1;
+      return ms;
    }
 
    /**
@@ -1016,12 +1280,18 @@ namespace eosiosystem {
     */
    void system_contract::process_rex_maturities( const rex_balance_table::const_iterator& bitr )
    {
-      const time_point_sec now = current_time_point_sec();
+      const uint32_t today = get_rex_day();
+      if ( bitr->maturity_slots.has_value() && bitr->maturity_slots.value().last_day == today ) {
+         return;
+      }
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         while ( !rb.rex_maturities.empty() && rb.rex_maturities.front().first <= now ) {
-            rb.matured_rex += rb.rex_maturities.front().second;
-            rb.rex_maturities.pop_front();
+         auto& ms = get_rex_maturity_slots( rb );
+         for ( uint32_t d = ms.last_day + 1; d <= today && d <= ms.last_day + num_of_maturity_buckets; ++d ) {
+            int64_t& bucket = ms.days[d % num_of_maturity_buckets];
+            rb.matured_rex += bucket;
+            bucket          = 0;
          }
+         ms.last_day = today;
       });
    }
 
@@ -1034,19 +1304,19 @@ namespace eosiosystem {
    void system_contract::consolidate_rex_balance( const rex_balance_table::const_iterator& bitr,
                                                   const asset& rex_in_sell_order )
    {
-      const int64_t rex_in_savings = read_rex_savings( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         auto& ms = get_rex_maturity_slots( rb );
          int64_t total  = rb.matured_rex - rex_in_sell_order.amount;
          rb.matured_rex = rex_in_sell_order.amount;
-         while ( !rb.rex_maturities.empty() ) {
-            total += rb.rex_maturities.front().second;
-            rb.rex_maturities.pop_front();
+         for ( auto& bucket : ms.days ) {
+            total += bucket;
+            bucket = 0;
          }
+         ms.last_day = get_rex_day();
          if ( total > 0 ) {
-            rb.rex_maturities.emplace_back( get_rex_maturity(), total );
+            ms.newest() = total;
          }
       });
-      put_rex_savings( bitr, rex_in_savings );
    }
 
    /**
@@ -1080,6 +1350,8 @@ namespace eosiosystem {
             rp.total_rent       = init_total_rent;
             rp.total_rex        = rex_received;
             rp.namebid_proceeds = asset( 0, core_symbol() );
+            rp.maintenance_mut().next_expiration = time_point_sec::maximum();
+            rp.maintenance_mut().open_orders     = false;
          });
       } else if ( !rex_available() ) { /// should be a rare corner case, REX pool is initialized but empty
          _rexpool.modify( itr, same_payer, [&]( auto& rp ) {
@@ -1125,9 +1397,11 @@ namespace eosiosystem {
       auto bitr = _rexbalance.find( owner.value );
       if ( bitr == _rexbalance.end() ) {
          bitr = _rexbalance.emplace( owner, [&]( auto& rb ) {
+            rb.version     = 1;
             rb.owner       = owner;
             rb.vote_stake  = payment;
             rb.rex_balance = rex_received;
+            rb.maturity_slots.emplace().last_day = get_rex_day();
          });
          current_rex_stake.amount = payment.amount;
       } else {
@@ -1140,63 +1414,13 @@ namespace eosiosystem {
          current_rex_stake.amount = bitr->vote_stake.amount;
       }
 
-      const int64_t rex_in_savings = read_rex_savings( bitr );
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex_received.amount;
-         } else {
-            rb.rex_maturities.emplace_back( maturity, rex_received.amount );
-         }
+         rb.maturity_slots.value().newest() += rex_received.amount;
       });
-      put_rex_savings( bitr, rex_in_savings );
       return current_rex_stake - init_rex_stake;
    }
 
-   /**
-    * @brief Reads amount of REX in savings bucket and removes the bucket from maturities
-    *
-    * Reads and (temporarily) removes REX savings bucket from REX maturities in order to
-    * allow uniform processing of remaining buckets as savings is a special case. This
-    * function is used in conjunction with put_rex_savings.
-    *
-    * @param bitr - iterator pointing to rex_balance object
-    *
-    * @return int64_t - amount of REX in savings bucket
-    */
-   int64_t system_contract::read_rex_savings( const rex_balance_table::const_iterator& bitr )
-   {
-      int64_t rex_in_savings = 0;
-      static const time_point_sec end_of_days = time_point_sec::maximum();
-      if ( !bitr->rex_maturities.empty() && bitr->rex_maturities.back().first == end_of_days ) {
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rex_in_savings = rb.rex_maturities.back().second;
-            rb.rex_maturities.pop_back();
-         });
-      }
-      return rex_in_savings;
-   }
-
-   /**
-    * @brief Adds a specified REX amount to savings bucket
-    *
-    * @param bitr - iterator pointing to rex_balance object
-    * @param rex - amount of REX to be added
-    */
-   void system_contract::put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex )
-   {
-      if ( rex == 0 ) return;
-      static const time_point_sec end_of_days = time_point_sec::maximum();
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == end_of_days ) {
-            rb.rex_maturities.back().second += rex;
-         } else {
-            rb.rex_maturities.emplace_back( end_of_days, rex );
-         }
-      });
-   }
-
    /**
     * @brief Updates voter REX vote stake to the current value of REX tokens held
     *
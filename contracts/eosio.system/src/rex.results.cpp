@@ -8,4 +8,6 @@ void rex_results::orderresult( const name& owner, const asset& proceeds ) { }
 
 void rex_results::rentresult( const asset& rented_tokens ) { }
 
+void rex_results::batchresult( const std::vector<std::pair<name, asset>>& filled_orders ) { }
+
 extern "C" void apply( uint64_t, uint64_t, uint64_t ) { }
@@ -35,7 +35,11 @@ namespace eosiosystem {
       auto prod = _producers.find( producer.value );
       const auto ct = current_time_point();
 
+      producer_votepay votepay;
+      votepay.last_votepay_share_update = ct;
+
       if ( prod != _producers.end() ) {
+         const bool add_votepay = !prod->votepay.has_value() && _producers2.find( producer.value ) == _producers2.end();
          _producers.modify( prod, producer, [&]( producer_info& info ){
             info.producer_key = producer_key;
             info.is_active    = true;
@@ -43,14 +47,17 @@ namespace eosiosystem {
             info.location     = location;
             if ( info.last_claim_time == time_point() )
                info.last_claim_time = ct;
+            if ( add_votepay && unified_producers() )
+               info.votepay.emplace( votepay );
          });
 
-         auto prod2 = _producers2.find( producer.value );
-         if ( prod2 == _producers2.end() ) {
-            _producers2.emplace( producer, [&]( producer_info2& info ){
-               info.owner                     = producer;
-               info.last_votepay_share_update = ct;
-            });
+         if ( add_votepay ) {
+            if ( !unified_producers() ) {
+               _producers2.emplace( producer, [&]( producer_info2& info ){
+                  info.owner                     = producer;
+                  info.last_votepay_share_update = ct;
+               });
+            }
             update_total_votepay_share( ct, 0.0, prod->total_votes );
             // When introducing the producer2 table row for the first time, the producer's votes must also be accounted for in the global total_producer_votepay_share at the same time.
          }
@@ -63,11 +70,15 @@ namespace eosiosystem {
             info.url             = url;
             info.location        = location;
             info.last_claim_time = ct;
+            if ( unified_producers() )
+               info.votepay.emplace( votepay );
          });
-         _producers2.emplace( producer, [&]( producer_info2& info ){
-            info.owner                     = producer;
-            info.last_votepay_share_update = ct;
-         });
+         if ( !unified_producers() ) {
+            _producers2.emplace( producer, [&]( producer_info2& info ){
+               info.owner                     = producer;
+               info.last_votepay_share_update = ct;
+            });
+         }
       }
 
    }
@@ -82,7 +93,10 @@ namespace eosiosystem {
    }
 
    void system_contract::update_elected_producers( block_timestamp block_time ) {
-      _gstate.last_producer_schedule_update = block_time;
+      _gstate.get_mut().last_producer_schedule_update = block_time;
+
+      /// every producer is ranked on its full total_votes
+      flush_pending_votes( std::numeric_limits<uint32_t>::max() );
 
       auto idx = _producers.get_index<"prototalvote"_n>();
 
@@ -93,7 +107,7 @@ namespace eosiosystem {
          top_producers.emplace_back( std::pair<eosio::producer_key,uint16_t>({{it->owner, it->producer_key}, it->location}) );
       }
 
-      if ( top_producers.size() < _gstate.last_producer_schedule_size ) {
+      if ( top_producers.size() < _gstate.get().last_producer_schedule_size ) {
          return;
       }
 
@@ -108,15 +122,27 @@ namespace eosiosystem {
 
       auto packed_schedule = pack(producers);
 
+      /// proposing the schedule proposed last time again would change nothing
+      const auto schedule_hash = eosio::sha256( packed_schedule.data(), packed_schedule.size() );
+      const auto& last_hash = _gstate2.get().last_proposed_schedule_hash;
+      if( last_hash.has_value() && last_hash.value() == schedule_hash ) {
+         return;
+      }
+
       if( set_proposed_producers( packed_schedule.data(),  packed_schedule.size() ) >= 0 ) {
-         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( top_producers.size() );
+         _gstate2.get_mut().last_proposed_schedule_hash.emplace( schedule_hash );
+         _gstate.get_mut().last_producer_schedule_size = static_cast<decltype(_gstate.get().last_producer_schedule_size)>( top_producers.size() );
       }
    }
 
    double stake2vote( int64_t staked ) {
       /// TODO subtract 2080 brings the large numbers closer to this decade
-      double weight = int64_t( (now() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) )  / double( 52 );
-      return double(staked) * std::pow( 2, weight );
+      /// the multiplier only changes once a week, so pow runs once per action rather than once per voter
+      const static double multiplier = [] {
+         double weight = int64_t( (now() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) )  / double( 52 );
+         return std::pow( 2, weight );
+      }();
+      return double(staked) * multiplier;
    }
 
    double system_contract::update_total_votepay_share( time_point ct,
@@ -124,27 +150,46 @@ namespace eosiosystem {
                                                        double shares_rate_delta )
    {
       double delta_total_votepay_share = 0.0;
-      if( ct > _gstate3.last_vpay_state_update ) {
-         delta_total_votepay_share = _gstate3.total_vpay_share_change_rate
-                                       * double( (ct - _gstate3.last_vpay_state_update).count() / 1E6 );
+      if( ct > _gstate3.get().last_vpay_state_update ) {
+         delta_total_votepay_share = _gstate3.get().total_vpay_share_change_rate
+                                       * double( (ct - _gstate3.get().last_vpay_state_update).count() / 1E6 );
       }
 
       delta_total_votepay_share += additional_shares_delta;
-      if( delta_total_votepay_share < 0 && _gstate2.total_producer_votepay_share < -delta_total_votepay_share ) {
-         _gstate2.total_producer_votepay_share = 0.0;
+      if( delta_total_votepay_share < 0 && _gstate2.get().total_producer_votepay_share < -delta_total_votepay_share ) {
+         _gstate2.get_mut().total_producer_votepay_share = 0.0;
       } else {
-         _gstate2.total_producer_votepay_share += delta_total_votepay_share;
+         _gstate2.get_mut().total_producer_votepay_share += delta_total_votepay_share;
       }
 
-      if( shares_rate_delta < 0 && _gstate3.total_vpay_share_change_rate < -shares_rate_delta ) {
-         _gstate3.total_vpay_share_change_rate = 0.0;
+      if( shares_rate_delta < 0 && _gstate3.get().total_vpay_share_change_rate < -shares_rate_delta ) {
+         _gstate3.get_mut().total_vpay_share_change_rate = 0.0;
       } else {
-         _gstate3.total_vpay_share_change_rate += shares_rate_delta;
+         _gstate3.get_mut().total_vpay_share_change_rate += shares_rate_delta;
       }
 
-      _gstate3.last_vpay_state_update = ct;
+      _gstate3.get_mut().last_vpay_state_update = ct;
 
-      return _gstate2.total_producer_votepay_share;
+      return _gstate2.get().total_producer_votepay_share;
+   }
+
+   double system_contract::accrue_votepay_share( producer_votepay& votepay, time_point ct,
+                                                 double shares_rate, bool reset_to_zero )
+   {
+      double delta_votepay_share = 0.0;
+      if( shares_rate > 0.0 && ct > votepay.last_votepay_share_update ) {
+         delta_votepay_share = shares_rate * double( (ct - votepay.last_votepay_share_update).count() / 1E6 ); // cannot be negative
+      }
+
+      double new_votepay_share = votepay.votepay_share + delta_votepay_share;
+      if( reset_to_zero )
+         votepay.votepay_share = 0.0;
+      else
+         votepay.votepay_share = new_votepay_share;
+
+      votepay.last_votepay_share_update = ct;
+
+      return new_votepay_share;
    }
 
    double system_contract::update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
@@ -152,24 +197,178 @@ namespace eosiosystem {
                                                           double shares_rate,
                                                           bool reset_to_zero )
    {
-      double delta_votepay_share = 0.0;
-      if( shares_rate > 0.0 && ct > prod_itr->last_votepay_share_update ) {
-         delta_votepay_share = shares_rate * double( (ct - prod_itr->last_votepay_share_update).count() / 1E6 ); // cannot be negative
-      }
+      producer_votepay votepay;
+      votepay.votepay_share             = prod_itr->votepay_share;
+      votepay.last_votepay_share_update = prod_itr->last_votepay_share_update;
 
-      double new_votepay_share = prod_itr->votepay_share + delta_votepay_share;
+      double new_votepay_share = accrue_votepay_share( votepay, ct, shares_rate, reset_to_zero );
       _producers2.modify( prod_itr, same_payer, [&](auto& p) {
-         if( reset_to_zero )
-            p.votepay_share = 0.0;
-         else
-            p.votepay_share = new_votepay_share;
-
-         p.last_votepay_share_update = ct;
+         p.votepay_share             = votepay.votepay_share;
+         p.last_votepay_share_update = votepay.last_votepay_share_update;
       } );
 
       return new_votepay_share;
    }
 
+   /**
+    *  Adds delta to the votes of prod and accrues its votepay share at the rate of the votes
+    *  held so far. A migrated producer is updated with a single row write, others also have
+    *  their producers2 row updated.
+    *
+    *  Unless its votepay share is about to be reset, the change for a migrated producer only
+    *  goes to the pendingvotes ledger, see fold_pending_votes.
+    */
+   void system_contract::update_producer_votes( const producer_info& prod, double delta, time_point ct, bool clamp_to_zero,
+                                                double& delta_change_rate, double& total_inactive_vpay_share )
+   {
+      if( prod.votepay.has_value() ) {
+         const auto& votepay = prod.votepay.value();
+         const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
+         bool crossed_threshold       = (last_claim_plus_3days <= ct);
+         bool updated_after_threshold = (last_claim_plus_3days <= votepay.last_votepay_share_update);
+
+         auto pv = _pendingvotes.find( prod.owner.value );
+         if( !crossed_threshold || updated_after_threshold ) {
+            const double delta_time = updated_after_threshold ? 0.0
+                                    : delta * double( (ct - votepay.last_votepay_share_update).count() / 1E6 );
+            if( pv == _pendingvotes.end() ) {
+               _pendingvotes.emplace( _self, [&]( auto& v ) {
+                  v.owner      = prod.owner;
+                  v.delta      = delta;
+                  v.delta_time = delta_time;
+               });
+            } else {
+               _pendingvotes.modify( pv, same_payer, [&]( auto& v ) {
+                  v.delta      += delta;
+                  v.delta_time += delta_time;
+               });
+            }
+            _gstate.get_mut().total_producer_vote_weight += delta;
+            if( !crossed_threshold ) {
+               delta_change_rate += delta;
+            }
+            return;
+         }
+
+         // votepay share gets reset below, so it must first accrue the pending votes
+         if( pv != _pendingvotes.end() ) {
+            fold_pending_votes( pv, prod, ct, delta_change_rate, total_inactive_vpay_share );
+         }
+      }
+
+      const double init_total_votes = prod.total_votes;
+
+      auto prod2 = _producers2.end();
+      time_point last_votepay_share_update;
+      if( prod.votepay.has_value() ) {
+         last_votepay_share_update = prod.votepay.value().last_votepay_share_update;
+      } else {
+         prod2 = _producers2.find( prod.owner.value );
+         if( prod2 != _producers2.end() )
+            last_votepay_share_update = prod2->last_votepay_share_update;
+      }
+      const bool has_votepay = prod.votepay.has_value() || prod2 != _producers2.end();
+
+      const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
+      bool crossed_threshold       = (last_claim_plus_3days <= ct);
+      bool updated_after_threshold = (last_claim_plus_3days <= last_votepay_share_update);
+      // Note: updated_after_threshold implies cross_threshold
+
+      const double shares_rate   = updated_after_threshold ? 0.0 : init_total_votes;
+      const bool   reset_to_zero = crossed_threshold && !updated_after_threshold; // only reset votepay_share once after threshold
+
+      double new_votepay_share = 0.0;
+      _producers.modify( prod, same_payer, [&]( auto& p ) {
+         p.total_votes += delta;
+         if ( clamp_to_zero && p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+            p.total_votes = 0;
+         }
+         _gstate.get_mut().total_producer_vote_weight += delta;
+         if( p.votepay.has_value() )
+            new_votepay_share = accrue_votepay_share( p.votepay.value(), ct, shares_rate, reset_to_zero );
+      });
+      if( prod2 != _producers2.end() )
+         new_votepay_share = update_producer_votepay_share( prod2, ct, shares_rate, reset_to_zero );
+
+      if( !has_votepay )
+         return;
+
+      if( !crossed_threshold ) {
+         delta_change_rate += delta;
+      } else if( !updated_after_threshold ) {
+         total_inactive_vpay_share += new_votepay_share;
+         delta_change_rate -= init_total_votes;
+      }
+   }
+
+   /**
+    *  Adds the pending votes of prod to its total_votes and accrues its votepay share as if each
+    *  change had been applied when it was cast:
+    *
+    *  (total_votes + delta) * (ct - last_votepay_share_update) - delta_time
+    *
+    *  The global vote pay change rate already followed each change, but if the threshold was
+    *  crossed meanwhile the share is reset here just as the next vote would have done.
+    *
+    *  Each delta removes at most what was added to the producer before, so the sum can only fall
+    *  below zero by floating point error. It is clamped like update_producer_votes does on a vote.
+    */
+   void system_contract::fold_pending_votes( const pending_votes_table::const_iterator& pv, const producer_info& prod, time_point ct,
+                                             double& delta_change_rate, double& total_inactive_vpay_share )
+   {
+      const double votes = prod.total_votes + pv->delta;
+      _producers.modify( prod, same_payer, [&]( auto& p ) {
+         p.total_votes = votes;
+         if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+            p.total_votes = 0;
+         }
+         if( !p.votepay.has_value() )
+            return;
+
+         auto& votepay = p.votepay.value();
+         const auto last_claim_plus_3days = p.last_claim_time + microseconds(3 * useconds_per_day);
+         if( last_claim_plus_3days <= votepay.last_votepay_share_update )
+            return; // not accruing
+
+         double new_votepay_share = votepay.votepay_share;
+         if( ct > votepay.last_votepay_share_update ) {
+            const double accrued = votes * double( (ct - votepay.last_votepay_share_update).count() / 1E6 ) - pv->delta_time;
+            if( accrued > 0 )
+               new_votepay_share += accrued;
+         }
+
+         if( last_claim_plus_3days <= ct ) {
+            votepay.votepay_share = 0.0;
+            total_inactive_vpay_share += new_votepay_share;
+            delta_change_rate -= votes;
+         } else {
+            votepay.votepay_share = new_votepay_share;
+         }
+         votepay.last_votepay_share_update = ct;
+      });
+      _pendingvotes.erase( pv );
+   }
+
+   void system_contract::flush_pending_votes( uint32_t max ) {
+      const auto ct = current_time_point();
+      double delta_change_rate         = 0.0;
+      double total_inactive_vpay_share = 0.0;
+      uint32_t i = 0;
+      for( auto pv = _pendingvotes.begin(); pv != _pendingvotes.end() && i < max; ++i, pv = _pendingvotes.begin() ) {
+         const auto& prod = _producers.get( pv->owner.value, "producer not found" ); //data corruption
+         fold_pending_votes( pv, prod, ct, delta_change_rate, total_inactive_vpay_share );
+      }
+      if( i > 0 ) {
+         update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      }
+   }
+
+   void system_contract::flushvotes( const name& user, uint16_t max ) {
+      require_auth( user );
+      check( max > 0, "max must be greater than 0" );
+      flush_pending_votes( max );
+   }
+
    /**
     *  @pre producers must be sorted from lowest to highest and must be registered and active
     *  @pre if proxy is set then no producers can be voted for
@@ -218,9 +417,9 @@ namespace eosiosystem {
        * their first vote and should consider their stake activated.
        */
       if( voter->last_vote_weight <= 0.0 ) {
-         _gstate.total_activated_stake += voter->staked;
-         if( _gstate.total_activated_stake >= min_activated_stake && _gstate.thresh_activated_stake_time == time_point() ) {
-            _gstate.thresh_activated_stake_time = current_time_point();
+         _gstate.get_mut().total_activated_stake += voter->staked;
+         if( _gstate.get().total_activated_stake >= min_activated_stake && _gstate.get().thresh_activated_stake_time == time_point() ) {
+            _gstate.get_mut().thresh_activated_stake_time = current_time_point();
          }
       }
 
@@ -274,35 +473,7 @@ namespace eosiosystem {
          auto pitr = _producers.find( pd.first.value );
          if( pitr != _producers.end() ) {
             check( !voting || pitr->active() || !pd.second.second /* not from new set */, "producer is not currently registered" );
-            double init_total_votes = pitr->total_votes;
-            _producers.modify( pitr, same_payer, [&]( auto& p ) {
-               p.total_votes += pd.second.first;
-               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                  p.total_votes = 0;
-               }
-               _gstate.total_producer_vote_weight += pd.second.first;
-               //check( p.total_votes >= 0, "something bad happened" );
-            });
-            auto prod2 = _producers2.find( pd.first.value );
-            if( prod2 != _producers2.end() ) {
-               const auto last_claim_plus_3days = pitr->last_claim_time + microseconds(3 * useconds_per_day);
-               bool crossed_threshold       = (last_claim_plus_3days <= ct);
-               bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-               // Note: updated_after_threshold implies cross_threshold
-
-               double new_votepay_share = update_producer_votepay_share( prod2,
-                                             ct,
-                                             updated_after_threshold ? 0.0 : init_total_votes,
-                                             crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                          );
-
-               if( !crossed_threshold ) {
-                  delta_change_rate += pd.second.first;
-               } else if( !updated_after_threshold ) {
-                  total_inactive_vpay_share += new_votepay_share;
-                  delta_change_rate -= init_total_votes;
-               }
-            }
+            update_producer_votes( *pitr, pd.second.first, ct, true, delta_change_rate, total_inactive_vpay_share );
          } else {
             check( !pd.second.second /* not from new set */, "producer is not registered" ); //data corruption
          }
@@ -368,31 +539,7 @@ namespace eosiosystem {
             double total_inactive_vpay_share = 0;
             for ( auto acnt : voter.producers ) {
                auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
-               const double init_total_votes = prod.total_votes;
-               _producers.modify( prod, same_payer, [&]( auto& p ) {
-                  p.total_votes += delta;
-                  _gstate.total_producer_vote_weight += delta;
-               });
-               auto prod2 = _producers2.find( acnt.value );
-               if ( prod2 != _producers2.end() ) {
-                  const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
-                  bool crossed_threshold       = (last_claim_plus_3days <= ct);
-                  bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-                  // Note: updated_after_threshold implies cross_threshold
-
-                  double new_votepay_share = update_producer_votepay_share( prod2,
-                                                ct,
-                                                updated_after_threshold ? 0.0 : init_total_votes,
-                                                crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                             );
-
-                  if( !crossed_threshold ) {
-                     delta_change_rate += delta;
-                  } else if( !updated_after_threshold ) {
-                     total_inactive_vpay_share += new_votepay_share;
-                     delta_change_rate -= init_total_votes;
-                  }
-               }
+               update_producer_votes( prod, delta, ct, false, delta_change_rate, total_inactive_vpay_share );
             }
 
             update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
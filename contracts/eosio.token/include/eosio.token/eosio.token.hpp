@@ -1,9 +1,16 @@
 #pragma once
 
 #include <eosiolib/asset.hpp>
+#include <eosiolib/binary_extension.hpp>
+#include <eosiolib/crypto.hpp>
 #include <eosiolib/eosio.hpp>
+#include <eosiolib/public_key.hpp>
+#include <eosiolib/signature.hpp>
 #include <eosiolib/singleton.hpp>
+#include <eosiolib/time.hpp>
 
+#include <array>
+#include <map>
 #include <string>
 
 namespace eosiosystem {
@@ -16,7 +23,14 @@ namespace eosio {
 
    class [[eosio::contract("eosio.token")]] token : public contract {
       public:
-         using contract::contract;
+         token( name receiver, name code, datastream<const char*> ds );
+
+         // one recipient of transfermany
+         struct transfer_param {
+            name     to;
+            asset    quantity;
+            string   memo;
+         };
 
          [[eosio::action]]
          void create( name   issuer,
@@ -25,6 +39,16 @@ namespace eosio {
          [[eosio::action]]
          void issue( name to, asset quantity, string memo );
 
+         // one receiver of issuemany
+         struct issue_param {
+            name     to;
+            asset    quantity;
+         };
+
+         // genesis and airdrop issuance, supply is updated once for the whole batch
+         [[eosio::action]]
+         void issuemany( const std::vector<issue_param>& issues, string memo );
+
          [[eosio::action]]
          void retire( asset quantity, string memo );
 
@@ -34,6 +58,11 @@ namespace eosio {
                         asset   quantity,
                         string  memo );
 
+         // receivers are notified of transfermany once, with every memo in transfers, and see no
+         // transfer action. Deposits detected from transfer notifications must be paid with transfer
+         [[eosio::action]]
+         void transfermany( name from, const std::vector<transfer_param>& transfers );
+
          [[eosio::action]]
          void open( name owner, const symbol& symbol, name ram_payer );
 
@@ -43,6 +72,7 @@ namespace eosio {
          [[eosio::action]]
          void staketrans( name from, name to, asset quantity, string memo );
 
+         // legacy, transfer settles its fee in place
          [[eosio::action]]
          void feecharge( name from, name to, asset fee, string memo );
 
@@ -65,8 +95,13 @@ namespace eosio {
          [[eosio::action]]
          void bonusfreeze( asset bonus, asset minimum, name collector );
 
+         // clear one abms shard in place, shards can be cleared side by side
          [[eosio::action]]
-         void bonusclear();
+         void bonusclear( uint8_t shard );
+
+         // clear up to max_accounts across the shards in one call
+         [[eosio::action]]
+         void bonusbulk( uint32_t max_accounts );
 
          [[eosio::action]]
          void bonus( name to );
@@ -74,6 +109,64 @@ namespace eosio {
          [[eosio::action]]
          void bonusclose( bool force );
 
+         // fold fee shards into eosio.saving, each shard is also swept once it holds
+         // HOT_FEE_SWEEP_ACCRUALS fees
+         [[eosio::action]]
+         void sweepfees();
+
+         // lazy bonus engine, O(1) per round
+         [[eosio::action]]
+         void bonusaccrue( asset bonus );
+
+         [[eosio::action]]
+         void claimbonus( name owner );
+
+         // move abms records into core balance rows, at most max_rows per call
+         [[eosio::action]]
+         void migrateabms( uint32_t max_rows );
+
+         // move abms records made before sharding out of scope 0 into their shards, scans at most max_rows per call
+         [[eosio::action]]
+         void shardabms( uint32_t max_rows );
+
+         // erase abms records with nothing left to accrue or clear, scans at most max_rows per call
+         [[eosio::action]]
+         void gcabms( uint32_t max_rows );
+
+         // announce a merkle distribution of total, nothing is issued until claimed
+         [[eosio::action]]
+         void setdrop( asset total, const checksum256& root, time_point_sec expiry );
+
+         // issue owner's leaf of the distribution, proof runs from the leaf up to the root
+         [[eosio::action]]
+         void claimdrop( name owner, asset amount, const std::vector<checksum256>& proof );
+
+         // remove an expired distribution, what was not claimed is never issued
+         [[eosio::action]]
+         void enddrop( symbol_code sym );
+
+         // chain id every channel state is signed for, set once before the first channel opens
+         [[eosio::action]]
+         void chinit( const checksum256& chain_id );
+
+         // lock quantity of core tokens into the channel of owner and peer, once per side
+         [[eosio::action]]
+         void chopen( name owner, name peer, asset quantity, const public_key& key );
+
+         // submit a balance state signed by both parties, a final one pays out at once and
+         // any other one starts closing, a newer nonce replaces it until the window passes
+         [[eosio::action]]
+         void chupdate( name a, name b, uint64_t nonce, asset balance_a, asset balance_b, bool final,
+                        const signature& sig_a, const signature& sig_b );
+
+         // ask to close on the latest submitted state, the peer may still submit a newer one
+         [[eosio::action]]
+         void chexit( name owner, name peer );
+
+         // pay out a channel whose dispute window has passed
+         [[eosio::action]]
+         void chfinish( name a, name b );
+
          static asset get_supply( name token_contract_account, symbol_code sym_code )
          {
             stats statstable( token_contract_account, sym_code.raw() );
@@ -90,15 +183,31 @@ namespace eosio {
 
          using create_action = eosio::action_wrapper<"create"_n, &token::create>;
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
+         using issuemany_action = eosio::action_wrapper<"issuemany"_n, &token::issuemany>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using staketrans_action = eosio::action_wrapper<"staketrans"_n, &token::staketrans>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transfermany_action = eosio::action_wrapper<"transfermany"_n, &token::transfermany>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
          using bonusfreeze_action = eosio::action_wrapper<"bonusfreeze"_n, &token::bonusfreeze>;
          using bonusclear_action = eosio::action_wrapper<"bonusclear"_n, &token::bonusclear>;
+         using bonusbulk_action = eosio::action_wrapper<"bonusbulk"_n, &token::bonusbulk>;
          using bonus_action = eosio::action_wrapper<"bonus"_n, &token::bonus>;
          using bonusclose_action = eosio::action_wrapper<"bonusclose"_n, &token::bonusclose>;
+         using sweepfees_action = eosio::action_wrapper<"sweepfees"_n, &token::sweepfees>;
+         using bonusaccrue_action = eosio::action_wrapper<"bonusaccrue"_n, &token::bonusaccrue>;
+         using claimbonus_action = eosio::action_wrapper<"claimbonus"_n, &token::claimbonus>;
+         using migrateabms_action = eosio::action_wrapper<"migrateabms"_n, &token::migrateabms>;
+         using shardabms_action = eosio::action_wrapper<"shardabms"_n, &token::shardabms>;
+         using gcabms_action = eosio::action_wrapper<"gcabms"_n, &token::gcabms>;
+         using setdrop_action = eosio::action_wrapper<"setdrop"_n, &token::setdrop>;
+         using claimdrop_action = eosio::action_wrapper<"claimdrop"_n, &token::claimdrop>;
+         using enddrop_action = eosio::action_wrapper<"enddrop"_n, &token::enddrop>;
+         using chopen_action = eosio::action_wrapper<"chopen"_n, &token::chopen>;
+         using chupdate_action = eosio::action_wrapper<"chupdate"_n, &token::chupdate>;
+         using chexit_action = eosio::action_wrapper<"chexit"_n, &token::chexit>;
+         using chfinish_action = eosio::action_wrapper<"chfinish"_n, &token::chfinish>;
          using issuetrans_action = eosio::action_wrapper<"issuetrans"_n, &token::issuetrans>;
          using feecharge_action = eosio::action_wrapper<"feecharge"_n, &token::feecharge>;
          using claimtrans_action = eosio::action_wrapper<"claimtrans"_n, &token::claimtrans>;
@@ -116,6 +225,8 @@ namespace eosio {
             int64_t   balance;      // bonus base balnace of *this* round
             int64_t   stake;        // staked balance
             asset     bonus;        // uncleared bonus shares
+            binary_extension<uint128_t>  paid_per_unit;   // bonus accumulator already settled into pending
+            binary_extension<int64_t>    pending;         // settled but unclaimed accrued bonus
 
             uint64_t primary_key() const { return owner.value; }
             uint64_t bonus_round_key() const { return round; }
@@ -136,8 +247,94 @@ namespace eosio {
             uint64_t primary_key() const { return id; }
          };
 
+         // clearing progress of one abms shard, kept in the shard's own scope
+         struct [[eosio::table]] bonus_shard {
+            uint64_t  round;        // bonus round this progress belongs to
+            bool      cleared;      // nothing left to clear in this shard
+            asset     paid;         // bonus credited in this shard, issued by bonusclose
+         };
+
+         // accumulator of the lazy bonus engine
+         struct [[eosio::table]] bonus_accumulator {
+            symbol     bonus_symbol; // bonus token, fixed by the first accrual
+            uint128_t  per_unit;     // accrued bonus per unit of (balance+stake), scaled by HOT_BONUS_PRECISION
+            int64_t    reserve;      // issued bonus which is not claimed yet
+            uint64_t   accruals;     // number of accrued rounds
+            binary_extension<bool>  core_v2;  // core balances keep their bonus meta in the accounts row
+            binary_extension<bool>  abms_sharded;  // no abms record made before sharding is left in scope 0
+         };
+
+         // transfer fees not swept into eosio.saving yet
+         struct [[eosio::table]] fee_shard {
+            uint64_t  id;           // shard selected by sender hash
+            asset     fee;          // unswept fee of this shard
+            uint32_t  accruals;     // fees accrued since this shard was last swept
+
+            uint64_t primary_key() const { return id; }
+         };
+
+         // where gcabms resumes its scan
+         struct [[eosio::table]] abms_gc_cursor {
+            uint64_t  shard;        // abms shard being scanned
+            uint64_t  owner;        // first owner not scanned yet
+         };
+
+         // where shardabms resumes its scan of scope 0
+         struct [[eosio::table]] abms_move_cursor {
+            uint64_t  owner;        // first owner not scanned yet
+         };
+
+         // merkle distribution of one token, issued lazily on claim
+         struct [[eosio::table]] drop_info {
+            asset           total;      // cap of the distribution
+            asset           claimed;    // issued by claims so far
+            checksum256     root;       // merkle root of the owner/amount leaves
+            time_point_sec  expiry;     // no claims from then on
+
+            uint64_t primary_key() const { return total.symbol.code().raw(); }
+         };
+
+         // distribution an owner last claimed from, by token
+         struct [[eosio::table]] drop_claim {
+            symbol          sym;
+            checksum256     root;       // root of the claimed distribution
+
+            uint64_t primary_key() const { return sym.code().raw(); }
+         };
+
+         // settlement channel of two parties, scoped by the smaller name. Deposits stay staked
+         // for their owner until payout, so fee and bonus only apply to the net result
+         struct [[eosio::table]] channel {
+            name            peer;         // the larger name
+            uint64_t        id;           // instance id, new each time the pair opens a channel
+            public_key      key_a;        // signs balance states for the scope party
+            public_key      key_b;        // signs balance states for peer
+            asset           deposit_a;
+            asset           deposit_b;
+            uint64_t        nonce;        // of the state a payout would use, 0 for the deposits
+            asset           balance_a;    // payout of that state
+            asset           balance_b;
+            time_point_sec  close_after;  // payout is possible from then on, zero while open
+
+            uint64_t primary_key() const { return peer.value; }
+         };
+
+         // shared by all channels, binds a signed state to one chain and one channel instance
+         struct [[eosio::table]] channel_config {
+            checksum256     chain_id;     // of the chain the states are signed for
+            uint64_t        next_id;      // instance id of the next opened channel
+         };
+
+         // bonus meta of a core balance, replaces its abms record
+         struct core_meta {
+            int64_t    stake;          // staked balance
+            uint128_t  paid_per_unit;  // bonus accumulator already settled into pending
+            int64_t    pending;        // settled but unclaimed accrued bonus
+         };
+
          struct [[eosio::table]] account {
             asset    balance;
+            binary_extension<core_meta>  meta;   // core symbol rows after migration only
             uint64_t primary_key() const { return balance.symbol.code().raw(); }
          };
 
@@ -157,13 +354,63 @@ namespace eosio {
             indexed_by<"bybonus"_n, const_mem_fun<account_bonus_meta, uint64_t, &account_bonus_meta::bonus_amount_key> > 
          > abms;
          typedef eosio::multi_index< "brnd"_n, bonus_round > brnd;
-
-         asset sub_balance( name owner, asset value );
-         asset add_balance( name owner, asset value, name ram_payer );
+         typedef eosio::singleton< "brshard"_n, bonus_shard > brshard;
+         typedef eosio::singleton< "bacc"_n, bonus_accumulator > bacc;
+         typedef eosio::multi_index< "feeshard"_n, fee_shard > feeshards;
+         typedef eosio::singleton< "abmsgc"_n, abms_gc_cursor > abmsgc;
+         typedef eosio::singleton< "abmsmove"_n, abms_move_cursor > abmsmove;
+         typedef eosio::multi_index< "drops"_n, drop_info > drops;
+         typedef eosio::multi_index< "dropclaims"_n, drop_claim > dropclaims;
+         typedef eosio::multi_index< "channels"_n, channel > channels;
+         typedef eosio::singleton< "chconfig"_n, channel_config > chconfig;
+
+         // bonus context of this action, shared by every balance change it makes
+         brnd                 _bonus_rounds;
+         std::map<uint64_t, abms>  _abms;   // by shard, opened on first use
+         const bonus_round*   _round = nullptr;
+         bool                 _round_loaded = false;
+
+         bacc                 _bonus_acc;
+         bonus_accumulator    _acc;
+         bool                 _acc_loaded = false;
+         feeshards            _fee_shards;
+
+         static time_point current_time_point();
+         const bonus_round* current_round();
+         const bonus_accumulator& accumulator();
+         int64_t accrued_bonus( int64_t base, uint128_t& paid );
+         void settle_accrued( account_bonus_meta& m );
+         static bool dormant_abms( const account_bonus_meta& m );
+         static checksum256 drop_leaf( name owner, const asset& amount );
+         static checksum256 drop_node( const checksum256& a, const checksum256& b );
+         checksum256 channel_digest( const channel& ch, name a, uint64_t nonce, const asset& balance_a, const asset& balance_b, bool final ) const;
+         asset channel_fee( const channel& ch, const asset& balance_a, const asset& balance_b ) const;
+         void pay_channel( name a, const channel& ch );
+         std::vector<name> bonus_accounts( const bonus_round& br, uint64_t shard, uint32_t max, bool& done_clear );
+
+         static uint64_t name_shard( name n, uint32_t bits );
+         abms& abms_shard( uint64_t shard );
+         std::pair<abms*, abms::const_iterator> find_abms( name owner );
+         bonus_shard shard_progress( const bonus_round& br, uint64_t shard ) const;
+         bool all_shards_cleared( const bonus_round& br ) const;
+         uint32_t clear_shard( const bonus_round& br, name issuer, uint64_t shard, uint32_t max );
+
+         asset sub_balance( name owner, asset value, int128_t stake_delta = 0 );
+         asset add_balance( name owner, asset value, name ram_payer, int128_t stake_delta = 0 );
+         bool core_v2();
+         bool abms_sharded();
+         bool is_core_v2( const account& a );
+         void update_core_meta( name owner, account& a, int128_t stake_delta );
          void on_balance_change(name owner, asset balance, name ram_payer, int128_t stake_delta);
-         asset calc_bonus(name owner, int64_t balance, int64_t stake) const;
-
-         void fee_free_transfer(name from, name to, asset quantity, string memo, std::vector<name> authes, name res_payer );
+         asset calc_bonus(const bonus_round& br, name owner, int64_t balance, int64_t stake) const;
+         asset transfer_fee( const asset& quantity ) const;
+         void accrue_fee( name from, const asset& fee );
+         void sweep_fees();
+
+         // authorities are fixed by each fee free action, payer pays for a new receiver row
+         template<size_t N>
+         void fee_free_transfer( name from, name to, const asset& quantity, const string& memo,
+                                 const std::array<name, N>& authes, name payer );
    };
 
 } /// namespace eosio
@@ -1,14 +1,36 @@
 #include <eosio.token/eosio.token.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 #define HOT_CORE_SYMBOL (symbol("HOT", 6))
 #define HOT_BONUS_SCOPE 0
+#define HOT_BONUS_SHARD_BITS 3
+#define HOT_BONUS_SHARDS (1u << HOT_BONUS_SHARD_BITS)
 #define HOT_BONUS_ACT_PER_ROUND 8
+#define HOT_BONUS_PRECISION (uint128_t(1000000000000000000ull))
+#define HOT_FEE_SHARD_BITS 4
+#define HOT_FEE_SWEEP_ACCRUALS 32
 #define HOT_SAVING_ACCOUNT (name("eosio.saving"))
 #define HOT_VPAY_ACCOUNT (name("eosio.vpay"))
 #define HOT_BPAY_ACCOUNT (name("eosio.bpay"))
+#define HOT_CHANNEL_DISPUTE_SEC (3*24*3600)
 
 namespace eosio {
 
+time_point token::current_time_point() {
+   const static time_point ct{ microseconds{ static_cast<int64_t>( current_time() ) } };
+   return ct;
+}
+
+token::token( name receiver, name code, datastream<const char*> ds )
+:contract(receiver, code, ds),
+ _bonus_rounds(_self, HOT_BONUS_SCOPE),
+ _bonus_acc(_self, HOT_BONUS_SCOPE),
+ _fee_shards(_self, HOT_BONUS_SCOPE)
+{
+}
+
 void token::create( name   issuer,
                     asset  maximum_supply )
 {
@@ -52,13 +74,47 @@ void token::issue( name to, asset quantity, string memo )
        s.supply += quantity;
     });
 
-    auto balance = add_balance( st.issuer, quantity, st.issuer );
-    on_balance_change(st.issuer, balance, st.issuer, 0);
-
     if ( to != st.issuer ) {
-      SEND_INLINE_ACTION( *this, issuetrans, { {st.issuer, "active"_n} },
-                          { to, quantity, memo }
-      );
+      check( is_account( to ), "to account does not exist");
+    }
+    // credit the receiver directly instead of passing through the issuer balance
+    add_balance( to, quantity, has_auth( to ) ? to : st.issuer );
+}
+
+void token::issuemany( const std::vector<issue_param>& issues, string memo )
+{
+    check( issues.size() > 0, "no issues given" );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    auto sym = issues.front().quantity.symbol;
+    check( sym.is_valid(), "invalid symbol name" );
+    stats statstable( _self, sym.code().raw() );
+    auto existing = statstable.find( sym.code().raw() );
+    check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
+    const auto& st = *existing;
+
+    require_auth( st.issuer );
+    check( sym == st.supply.symbol, "symbol precision mismatch" );
+
+    asset total( 0, sym );
+    for ( const auto& i : issues ) {
+       check( i.quantity.is_valid(), "invalid quantity" );
+       check( i.quantity.amount > 0, "must issue positive quantity" );
+       check( i.quantity.symbol == sym, "all issues should be the same token" );
+       total += i.quantity;
+    }
+    check( total.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+
+    statstable.modify( st, same_payer, [&]( auto& s ) {
+       s.supply += total;
+    });
+
+    // the issuer signs for the batch and pays for new rows
+    for ( const auto& i : issues ) {
+       if ( i.to != st.issuer ) {
+          check( is_account( i.to ), "to account does not exist");
+       }
+       add_balance( i.to, i.quantity, st.issuer );
     }
 }
 
@@ -86,35 +142,31 @@ void token::retire( asset quantity, string memo )
     sub_balance( st.issuer, quantity );
 }
 
-void token::fee_free_transfer(name from, name to, asset quantity, string memo, std::vector<name> authes, name res_payer )
+template<size_t N>
+void token::fee_free_transfer( name from, name to, const asset& quantity, const string& memo,
+                               const std::array<name, N>& authes, name payer )
 {
+   // from is one of our own payout accounts or the issuer, sub_balance fails if it holds nothing
    check( from != to, "cannot transfer to self" );
-   check( is_account( from ), "from account does not exist");
    check( is_account( to ), "to account does not exist");
 
-   auto sym = quantity.symbol.code();
-   stats statstable( _self, sym.raw() );
-   const auto& st = statstable.get( sym.raw() );
-
    check( quantity.is_valid(), "invalid quantity" );
    check( quantity.amount > 0, "must transfer positive quantity" );
-   check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
    check( memo.size() <= 256, "memo has more than 256 bytes" );
-   
-   // check auth
-   for ( auto it : authes ) {
-      require_auth( it );
+   if ( quantity.symbol != HOT_CORE_SYMBOL ) {
+      // precision of the core symbol is fixed, any other one is checked against its stats
+      auto sym = quantity.symbol.code();
+      stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw() );
+      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
    }
 
-   auto payer = has_auth( to ) ? to : from;
-   if ( res_payer != name() ) {
-      payer = res_payer;
+   for ( const auto& auth : authes ) {
+      require_auth( auth );
    }
-   
-   auto blc_from = sub_balance( from, quantity );
-   on_balance_change( from, blc_from, same_payer, 0);
-   auto blc_to = add_balance( to, quantity, payer );
-   on_balance_change(to, blc_to, payer, 0);   
+
+   sub_balance( from, quantity );
+   add_balance( to, quantity, payer );
 }
 
 void token::issuetrans( name    to,
@@ -124,7 +176,8 @@ void token::issuetrans( name    to,
    auto sym = quantity.symbol.code();
    stats statstable( _self, sym.raw() );
    const auto& st = statstable.get( sym.raw() );
-   fee_free_transfer( st.issuer, to, quantity, memo, {st.issuer}, name() );
+   check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+   fee_free_transfer( st.issuer, to, quantity, memo, std::array<name, 1>{ st.issuer }, has_auth( to ) ? to : st.issuer );
 }
 
 void token::claimtrans( name  claimer,
@@ -132,21 +185,21 @@ void token::claimtrans( name  claimer,
                       asset   quantity,
                       string  memo )
 {
-   fee_free_transfer( HOT_SAVING_ACCOUNT, to, quantity, memo, { claimer, HOT_SAVING_ACCOUNT,  }, claimer );
+   fee_free_transfer( HOT_SAVING_ACCOUNT, to, quantity, memo, std::array<name, 2>{ claimer, HOT_SAVING_ACCOUNT }, claimer );
 }
 
 void token::vpaytrans( name    to,
                       asset   quantity,
                       string  memo )
 {
-   fee_free_transfer( HOT_VPAY_ACCOUNT, to, quantity, memo, { to, HOT_VPAY_ACCOUNT,  }, to );
+   fee_free_transfer( HOT_VPAY_ACCOUNT, to, quantity, memo, std::array<name, 2>{ to, HOT_VPAY_ACCOUNT }, to );
 }
 
 void token::bpaytrans( name    to,
                       asset   quantity,
                       string  memo )
 {
-   fee_free_transfer( HOT_BPAY_ACCOUNT, to, quantity, memo, { to, HOT_BPAY_ACCOUNT,  }, to );
+   fee_free_transfer( HOT_BPAY_ACCOUNT, to, quantity, memo, std::array<name, 2>{ to, HOT_BPAY_ACCOUNT }, to );
 }
 
 void token::transfer( name    from,
@@ -182,24 +235,153 @@ void token::transfer( name    from,
        charge_fee = true;
     }
     
-    auto blc_from = sub_balance( from, quantity );
-    on_balance_change(from, blc_from, same_payer, stake);
-    auto blc_to = add_balance( to, quantity, payer );
-    on_balance_change(to, blc_to, payer, stake);
-
+    // fee is settled within this action instead of an inline feecharge
+    asset fee( 0, HOT_CORE_SYMBOL );
     if ( charge_fee ) {
-      // 1/1000 or 1000u at least
-      int64_t fee_amt = quantity.amount / 1000;
-      if ( fee_amt < 1000 ) {
-         fee_amt = 1000;
-      }       
-      SEND_INLINE_ACTION( *this, feecharge, { {from, "active"_n} },
-                          { from, to, asset( fee_amt, HOT_CORE_SYMBOL ), memo }
-      );
+       fee = transfer_fee( quantity );
+    }
+
+    if ( fee.amount > 0 && fee.symbol == quantity.symbol ) {
+       // fee comes out of the same balance row, debit both at once
+       sub_balance( from, quantity + fee, stake );
+    } else {
+       sub_balance( from, quantity, stake );
+       if ( fee.amount > 0 ) {
+          sub_balance( from, fee );
+       }
+    }
+    add_balance( to, quantity, payer, stake );
+
+    if ( fee.amount > 0 ) {
+       accrue_fee( from, fee );
+    }
+}
+
+void token::transfermany( name from, const std::vector<transfer_param>& transfers )
+{
+    require_auth( from );
+    check( transfers.size() > 0, "no transfers given" );
+    check( from != stake_account, "cannot batch transfer from stake account" );
+
+    auto sym = transfers.front().quantity.symbol;
+    stats statstable( _self, sym.code().raw() );
+    const auto& st = statstable.get( sym.code().raw() );
+    check( sym == st.supply.symbol, "symbol precision mismatch" );
+
+    require_recipient( from );
+
+    // aggregate credits per recipient so each row is written and notified once
+    std::map<name, asset> credits;
+    asset total( 0, sym );
+    asset fee( 0, HOT_CORE_SYMBOL );
+    for ( const auto& t : transfers ) {
+       check( from != t.to, "cannot transfer to self" );
+       check( t.to != stake_account, "cannot batch transfer to stake account" );
+       check( t.quantity.is_valid(), "invalid quantity" );
+       check( t.quantity.amount > 0, "must transfer positive quantity" );
+       check( t.quantity.symbol == sym, "all transfers should be the same token" );
+       check( t.memo.size() <= 256, "memo has more than 256 bytes" );
+
+       total += t.quantity;
+       // each transfer pays the same fee as a single transfer would
+       fee += transfer_fee( t.quantity );
+
+       auto it = credits.find( t.to );
+       if ( it == credits.end() ) {
+          credits.emplace( t.to, t.quantity );
+       } else {
+          it->second += t.quantity;
+       }
     }
+
+    if ( fee.symbol == sym ) {
+       sub_balance( from, total + fee );
+    } else {
+       sub_balance( from, total );
+       sub_balance( from, fee );
+    }
+
+    for ( const auto& c : credits ) {
+       check( is_account( c.first ), "to account does not exist");
+       require_recipient( c.first );
+
+       auto payer = has_auth( c.first ) ? c.first : from;
+       add_balance( c.first, c.second, payer );
+    }
+
+    accrue_fee( from, fee );
+}
+
+asset token::transfer_fee( const asset& quantity ) const
+{
+   // 1/1000 or 1000u at least
+   int64_t fee_amt = quantity.amount / 1000;
+   if ( fee_amt < 1000 ) {
+      fee_amt = 1000;
+   }
+   return asset( fee_amt, HOT_CORE_SYMBOL );
 }
 
+// fees land in one of 2^HOT_FEE_SHARD_BITS rows instead of the single eosio.saving row,
+// a shard is swept on its own every HOT_FEE_SWEEP_ACCRUALS fees so eosio.saving never lags far
+void token::accrue_fee( name from, const asset& fee )
+{
+   const uint64_t id = name_shard( from, HOT_FEE_SHARD_BITS );
+   auto it = _fee_shards.find( id );
+   if ( it == _fee_shards.end() ) {
+      _fee_shards.emplace( _self, [&]( auto& f ) {
+         f.id = id;
+         f.fee = fee;
+         f.accruals = 1;
+      });
+      return;
+   }
+
+   asset swept( 0, HOT_CORE_SYMBOL );
+   _fee_shards.modify( it, same_payer, [&]( auto& f ) {
+      f.fee += fee;
+      if ( ++f.accruals >= HOT_FEE_SWEEP_ACCRUALS ) {
+         swept = f.fee;
+         f.fee.amount = 0;
+         f.accruals = 0;
+      }
+   });
+   if ( swept.amount > 0 ) {
+      add_balance( HOT_SAVING_ACCOUNT, swept, _self );
+   }
+}
+
+// fibonacci hashing into 2^bits shards, low bits of a name are mostly zero
+uint64_t token::name_shard( name n, uint32_t bits )
+{
+   return ( n.value * 11400714819323198485ull ) >> ( 64 - bits );
+}
+
+void token::sweep_fees()
+{
+   asset total( 0, HOT_CORE_SYMBOL );
+   for ( auto it = _fee_shards.begin(); it != _fee_shards.end(); ++it ) {
+      if ( it->fee.amount <= 0 ) {
+         continue;
+      }
+      total += it->fee;
+      _fee_shards.modify( it, same_payer, [&]( auto& f ) {
+         f.fee.amount = 0;
+         f.accruals = 0;
+      });
+   }
+
+   if ( total.amount > 0 ) {
+      add_balance( HOT_SAVING_ACCOUNT, total, _self );
+   }
+}
+
+void token::sweepfees()
+{
+   sweep_fees();
+}
 
+// legacy entry point, transfer no longer dispatches it
 void token::feecharge( name   from,
                       name    to,
                       asset   fee,
@@ -218,10 +400,8 @@ void token::feecharge( name   from,
     
     auto payer = has_auth( to ) ? to : from;
 
-    auto blc_from = sub_balance( from, fee );
-    on_balance_change(from, blc_from, same_payer, 0);
-    auto saving_balance = add_balance( HOT_SAVING_ACCOUNT, fee, payer );
-    on_balance_change(HOT_SAVING_ACCOUNT, saving_balance, payer, 0);
+    sub_balance( from, fee );
+    add_balance( HOT_SAVING_ACCOUNT, fee, payer );
 }
 
 void token::staketrans(    name    from,
@@ -248,50 +428,110 @@ void token::staketrans(    name    from,
 
     int128_t stake = int128_t(quantity.amount);
 
-    auto blc_from = sub_balance( from, quantity );
-    on_balance_change( from, blc_from, same_payer, 0 );
+    sub_balance( from, quantity );
 
     auto zero_quatity = quantity;
     zero_quatity.amount = 0;
-    auto blc_to = add_balance( to, zero_quatity, from );
-    on_balance_change( to, blc_to, payer, stake );
+    add_balance( to, zero_quatity, from, stake );
 
-    auto blc_stake = add_balance( stake_account, quantity, payer );
-    on_balance_change( stake_account, blc_stake, payer, stake );
+    add_balance( stake_account, quantity, payer, stake );
 }
 
-asset token::sub_balance( name owner, asset value ) {
+asset token::sub_balance( name owner, asset value, int128_t stake_delta ) {
     accounts from_acnts( _self, owner.value );
     
     const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
     check( from.balance.amount >= value.amount, "overdrawn balance" );
+    const bool v2 = is_core_v2( from );
     asset balance;
     from_acnts.modify( from, owner, [&]( auto& a ) {
+       if ( v2 ) {
+          update_core_meta( owner, a, stake_delta );
+       }
        a.balance -= value;
        balance = a.balance;
     });
+    if ( !v2 ) {
+       on_balance_change( owner, balance, owner, stake_delta );
+    }
    return balance;
 }
 
-asset token::add_balance( name owner, asset value, name ram_payer )
+asset token::add_balance( name owner, asset value, name ram_payer, int128_t stake_delta )
 {
    accounts to_acnts( _self, owner.value );
    auto to = to_acnts.find( value.symbol.code().raw() );
+   bool v2 = false;
    asset balance;
    if( to == to_acnts.end() ) {
+      v2 = value.symbol == HOT_CORE_SYMBOL && core_v2();
       to_acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = value;
+        a.balance = asset( 0, value.symbol );
+        if ( v2 ) {
+           update_core_meta( owner, a, stake_delta );
+        }
+        a.balance += value;
         balance = a.balance;
       });
    } else {
-      to_acnts.modify( to, same_payer, [&]( auto& a ) {
+      v2 = is_core_v2( *to );
+      // a legacy row grows once on conversion, growing it needs its payer's authority, so the
+      // owner takes it over when it signs and the contract pays only when nobody else can
+      const auto payer = ( v2 && !to->meta.has_value() ) ? ( ram_payer == owner ? owner : _self ) : same_payer;
+      to_acnts.modify( to, payer, [&]( auto& a ) {
+        if ( v2 ) {
+           update_core_meta( owner, a, stake_delta );
+        }
         a.balance += value;
         balance = a.balance;
       });      
    }
+   if ( !v2 ) {
+      on_balance_change( owner, balance, ram_payer, stake_delta );
+   }
    return balance;
 }
 
+// core balance row carrying its own bonus meta, legacy rows convert on first touch once migration started
+bool token::is_core_v2( const account& a ) {
+   return a.balance.symbol == HOT_CORE_SYMBOL && ( a.meta.has_value() || core_v2() );
+}
+
+bool token::core_v2() {
+   const auto& acc = accumulator();
+   return acc.core_v2.has_value() && acc.core_v2.value();
+}
+
+bool token::abms_sharded() {
+   const auto& acc = accumulator();
+   return acc.abms_sharded.has_value() && acc.abms_sharded.value();
+}
+
+// settle the bonus accrued on the balance held so far, then apply stake_delta
+void token::update_core_meta( name owner, account& a, int128_t stake_delta )
+{
+   if ( !a.meta.has_value() ) {
+      core_meta meta{ 0, accumulator().per_unit, 0 };
+      // take over the legacy abms record, if there is one
+      auto [tbl, it] = find_abms( owner );
+      if ( it != tbl->end() ) {
+         auto m = *it;
+         settle_accrued( m );
+         meta.stake = m.stake;
+         meta.paid_per_unit = m.paid_per_unit.value();
+         meta.pending = m.pending.value();
+         tbl->erase( it );
+      } else {
+         check( stake_delta >= 0, "first time stake should not be negtive" );
+      }
+      a.meta.emplace( meta );
+   }
+   auto& meta = a.meta.value();
+   int64_t base = ( owner == stake_account ) ? a.balance.amount - meta.stake : a.balance.amount + meta.stake;
+   meta.pending += accrued_bonus( base, meta.paid_per_unit );
+   meta.stake = int64_t( int128_t(meta.stake) + stake_delta );
+}
+
 void token::on_balance_change( name owner, asset balance, name ram_payer, int128_t stake_delta )
 {
    // only update on core asset balance changing
@@ -299,39 +539,47 @@ void token::on_balance_change( name owner, asset balance, name ram_payer, int128
       return;
    }
    // find newest round number
-   brnd bonus_rounds( _self, HOT_BONUS_SCOPE );
+   const auto br = current_round();
    uint64_t round_num = 0;
-   auto it_latest = bonus_rounds.begin();
-   if (it_latest != bonus_rounds.end()) {
-      round_num = it_latest->round;
+   if ( br != nullptr ) {
+      round_num = br->round;
    }
    // update bonus meta
-   abms to_abms( _self, HOT_BONUS_SCOPE );
-   auto it_to = to_abms.find( owner.value );
-   if ( it_to == to_abms.end() ) {
+   auto [tbl, it_to] = find_abms( owner );
+   if ( it_to == tbl->end() ) {
       check( stake_delta >= 0, "first time stake should not be negtive" );
+      if ( balance.amount == 0 && stake_delta == 0 ) {
+         // nothing to accrue on, do not make a dormant record
+         return;
+      }
       // if no abms record, create a new one
-      to_abms.emplace( ram_payer, [&]( auto &m ) {
+      tbl->emplace( ram_payer, [&]( auto &m ) {
          m.owner = owner;
          m.round = round_num;
          m.balance = balance.amount;
          m.bonus = asset();
          m.stake = int64_t(stake_delta);
+         m.paid_per_unit.emplace( accumulator().per_unit );
+         m.pending.emplace( 0 );
       });
    } else {
       int64_t stake = int64_t(int128_t(it_to->stake) + stake_delta);
+      // rows created before the lazy engine grow once, like legacy balance rows in add_balance
+      const auto payer = it_to->paid_per_unit.has_value() ? same_payer : ( ram_payer == owner ? owner : _self );
       // compare current round number to abms
       if ( it_to->round + 1 == round_num ) {
          // new round is started since last update
-         to_abms.modify( it_to, same_payer, [&]( auto &m ) {   
-            m.bonus = calc_bonus( m.owner, m.balance, m.stake );
+         tbl->modify( it_to, payer, [&]( auto &m ) {   
+            m.bonus = calc_bonus( *br, m.owner, m.balance, m.stake );
+            settle_accrued( m );
             m.round = round_num;
             m.balance = balance.amount;
             m.stake = stake;
          });
       } else if ( it_to->round == round_num ) {
          // update abms record
-         to_abms.modify( it_to, same_payer, [&]( auto &m ) {
+         tbl->modify( it_to, payer, [&]( auto &m ) {
+            settle_accrued( m );
             m.balance = balance.amount;
             m.stake = stake;
          });
@@ -339,25 +587,116 @@ void token::on_balance_change( name owner, asset balance, name ram_payer, int128
          // this should not happen
          check( false, "abms round number should <= current round number" );
       }
+      // the record is made again on the next credit, with nothing owed in between
+      if ( dormant_abms( *it_to ) ) {
+         tbl->erase( it_to );
+      }
    }
 }
 
+// latest bonus round, read at most once per action
+const token::bonus_round* token::current_round() {
+   if ( !_round_loaded ) {
+      auto it = _bonus_rounds.begin();
+      _round = it != _bonus_rounds.end() ? &*it : nullptr;
+      _round_loaded = true;
+   }
+   return _round;
+}
+
+// abms table of one shard, shard 0 shares its scope with the records made before sharding
+token::abms& token::abms_shard( uint64_t shard )
+{
+   return _abms.try_emplace( shard, _self, HOT_BONUS_SCOPE + shard ).first->second;
+}
+
+// owner's abms record and the table holding it, end of the owner's shard table if there is none
+std::pair<token::abms*, token::abms::const_iterator> token::find_abms( name owner )
+{
+   const uint64_t shard = name_shard( owner, HOT_BONUS_SHARD_BITS );
+   auto& tbl = abms_shard( shard );
+   auto it = tbl.find( owner.value );
+   if ( it == tbl.end() && shard != 0 && !abms_sharded() ) {
+      // records made before sharding stay in scope 0 until shardabms moves them
+      auto& legacy = abms_shard( 0 );
+      auto it_legacy = legacy.find( owner.value );
+      if ( it_legacy != legacy.end() ) {
+         return { &legacy, it_legacy };
+      }
+   }
+   return { &tbl, it };
+}
+
+// clearing progress of shard in round br, a row left from an earlier round counts as not started
+token::bonus_shard token::shard_progress( const bonus_round& br, uint64_t shard ) const
+{
+   brshard progress( _self, HOT_BONUS_SCOPE + shard );
+   auto p = progress.get_or_default( bonus_shard{} );
+   if ( p.round != br.round ) {
+      p = bonus_shard{ br.round, false, asset( 0, br.bonus.symbol ) };
+   }
+   return p;
+}
+
+bool token::all_shards_cleared( const bonus_round& br ) const
+{
+   for ( uint64_t shard = 0; shard < HOT_BONUS_SHARDS; ++shard ) {
+      if ( !shard_progress( br, shard ).cleared ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+// lazy bonus engine state, read at most once per action
+const token::bonus_accumulator& token::accumulator() {
+   if ( !_acc_loaded ) {
+      _acc = _bonus_acc.get_or_default( bonus_accumulator{} );
+      _acc_loaded = true;
+   }
+   return _acc;
+}
+
+// bonus accrued on base since paid, moves paid up to the current accumulator
+int64_t token::accrued_bonus( int64_t base, uint128_t& paid ) {
+   const auto& acc = accumulator();
+   int64_t bonus = 0;
+   if ( acc.per_unit > paid && base > 0 ) {
+      bonus = int64_t( uint128_t(base) * ( acc.per_unit - paid ) / HOT_BONUS_PRECISION );
+   }
+   paid = acc.per_unit;
+   return bonus;
+}
+
+// fold bonus accrued since the last settlement into pending, based on the balance held meanwhile
+void token::settle_accrued( account_bonus_meta& m ) {
+   uint128_t paid = m.paid_per_unit.has_value() ? m.paid_per_unit.value() : 0;
+   int64_t pending = m.pending.has_value() ? m.pending.value() : 0;
+   int64_t base = ( m.owner == stake_account ) ? m.balance - m.stake : m.balance + m.stake;
+   pending += accrued_bonus( base, paid );
+   m.paid_per_unit.emplace( paid );
+   m.pending.emplace( pending );
+}
+
+// nothing held, staked, uncleared or unclaimed
+bool token::dormant_abms( const account_bonus_meta& m ) {
+   return m.balance == 0 && m.stake == 0 && m.bonus.amount <= 0
+      && ( !m.pending.has_value() || m.pending.value() == 0 );
+}
+
 // caculate bonus of last round
-asset token::calc_bonus(name owner, int64_t balance, int64_t stake) const {
-   brnd bonus_rounds( _self, HOT_BONUS_SCOPE );
-   auto it = bonus_rounds.begin();
-   check( it != bonus_rounds.end(), "bonus round not found" );
-   check( it->clearing, "calc_bonus should be called during clearing" );
+asset token::calc_bonus(const bonus_round& br, name owner, int64_t balance, int64_t stake) const {
+   check( br.clearing, "calc_bonus should be called during clearing" );
    int128_t bonus_val = 0;
    if ( owner == stake_account ) {
       check( balance >= stake, "stake_account's balance should be greater than stake" );
-      bonus_val = int128_t(it->bonus.amount) * int128_t(balance - stake);
+      bonus_val = int128_t(br.bonus.amount) * int128_t(balance - stake);
    } else {
-      bonus_val = int128_t(it->bonus.amount) * int128_t(balance + stake);
+      bonus_val = int128_t(br.bonus.amount) * int128_t(balance + stake);
    }
-   bonus_val /= int128_t(it->clearbase);
-   // asset bonus = it->bonus * balance / it->clearbase;
-   asset bonus = it->bonus;
+   bonus_val /= int128_t(br.clearbase);
+   // asset bonus = br.bonus * balance / br.clearbase;
+   asset bonus = br.bonus;
    bonus.amount = int64_t(bonus_val);
    return bonus;
 }
@@ -378,6 +717,9 @@ void token::open( name owner, const symbol& symbol, name ram_payer )
    if( it == acnts.end() ) {
       acnts.emplace( ram_payer, [&]( auto& a ){
         a.balance = asset{0, symbol};
+        if ( is_core_v2( a ) ) {
+           update_core_meta( owner, a, 0 );
+        }
       });
    }
 }
@@ -389,6 +731,11 @@ void token::close( name owner, const symbol& symbol )
    auto it = acnts.find( symbol.code().raw() );
    check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
    check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
+   if ( it->meta.has_value() ) {
+      // with a zero balance nothing accrues on top of stake, which must be zero too
+      check( it->meta.value().stake == 0, "Cannot close because the staked balance is not zero." );
+      check( it->meta.value().pending == 0, "Cannot close because the bonus is not claimed." );
+   }
    acnts.erase( it );
 }
 
@@ -400,6 +747,7 @@ void token::bonusfreeze( asset bonus, asset minimum, name collector )
    check( bonus.amount > 0, "bonus amount should greator than 0" );
    check( bonus.amount >= minimum.amount, "bonus amount should not be smaller than minimum amount" );
    check( is_account( collector ), "collector account does not exist");
+   check( !core_v2(), "bonus rounds are retired after core balance migration, use bonusaccrue" );
 
    // check existance of bonus token
    stats stat_bonus( _self, bonus.symbol.code().raw() );
@@ -407,19 +755,32 @@ void token::bonusfreeze( asset bonus, asset minimum, name collector )
    check( it_stat_bonus != stat_bonus.end(), "token with bonus symbol does not exist, cannot freeze bonus" );
    const auto& st = *it_stat_bonus;
    require_auth( st.issuer );
+   check( bonus.symbol == st.supply.symbol, "symbol precision mismatch" );
+   check( bonus.amount <= st.max_supply.amount - st.supply.amount, "bonus exceeds available supply" );
+
+   // unswept fees belong to eosio.saving's bonus base
+   sweep_fees();
 
    // get current CORE ASSET supply
    stats stat_core( _self, HOT_CORE_SYMBOL.code().raw() );
    auto it_stat_core = stat_core.find( HOT_CORE_SYMBOL.code().raw() );
    check( it_stat_core != stat_core.end(), "core asset token does not exist, cannot freeze bonus" );
    int64_t supply = it_stat_core->supply.amount;
+   // bonus reserved by the lazy engine is not held by anyone yet
+   if ( accumulator().bonus_symbol == HOT_CORE_SYMBOL ) {
+      supply -= accumulator().reserve;
+   }
+
+   // the whole bonus is issued now, so crediting holders while clearing cannot outgrow max supply
+   stat_bonus.modify( st, same_payer, [&]( auto& s ) {
+      s.supply += bonus;
+   });
 
    // update round info
-   brnd bonus_rounds( _self, HOT_BONUS_SCOPE );
-   auto it_br = bonus_rounds.begin();
-   if ( it_br == bonus_rounds.end() ) {
+   const auto it_br = current_round();
+   if ( it_br == nullptr ) {
       // this is the first time freeze
-      bonus_rounds.emplace(st.issuer, [&]( auto &br ) {
+      _bonus_rounds.emplace(st.issuer, [&]( auto &br ) {
          br.id = 1;
          br.round = 1;
          br.clearing = true;
@@ -429,9 +790,10 @@ void token::bonusfreeze( asset bonus, asset minimum, name collector )
          br.balance = bonus;
          br.collector = collector;
       });
+      _round_loaded = false;
    } else {
       check(!it_br->clearing, "in process of clearing, cannot freeze bonus");
-      bonus_rounds.modify( *it_br, same_payer, [&]( auto &br ) {
+      _bonus_rounds.modify( *it_br, same_payer, [&]( auto &br ) {
          br.round += 1;
          br.clearing = true;
          br.clearbase = supply;
@@ -443,12 +805,14 @@ void token::bonusfreeze( asset bonus, asset minimum, name collector )
    }
 }
 
-void token::bonusclear()
+void token::bonusclear( uint8_t shard )
 {
-   brnd bonus_rounds( _self, HOT_BONUS_SCOPE );
-   auto it_br = bonus_rounds.begin();
-   check( it_br != bonus_rounds.end(), "bonus round not found" );
+   check( shard < HOT_BONUS_SHARDS, "invalid abms shard" );
+
+   const auto it_br = current_round();
+   check( it_br != nullptr, "bonus round not found" );
    check( it_br->clearing, "bonus round has not been frozen yet" );
+   check( !shard_progress( *it_br, shard ).cleared, "abms shard is already cleared" );
 
    stats statstable( _self, it_br->bonus.symbol.code().raw() );
    auto existing = statstable.find( it_br->bonus.symbol.code().raw() );
@@ -456,24 +820,98 @@ void token::bonusclear()
    const auto& st = *existing;
    require_auth( st.issuer );
 
-   std::vector<name> bonus_accs;
+   clear_shard( *it_br, st.issuer, shard, HOT_BONUS_ACT_PER_ROUND );
+
+   // the round closes after the last shard is cleared
+   if ( all_shards_cleared( *it_br ) ) {
+      SEND_INLINE_ACTION( *this, bonusclose, { {st.issuer, "active"_n} }, { false } );
+   }
+}
+
+void token::bonusbulk( uint32_t max_accounts )
+{
+   check( max_accounts > 0, "max_accounts should be greater than 0" );
+
+   const auto it_br = current_round();
+   check( it_br != nullptr, "bonus round not found" );
+   check( it_br->clearing, "bonus round has not been frozen yet" );
+
+   stats statstable( _self, it_br->bonus.symbol.code().raw() );
+   auto existing = statstable.find( it_br->bonus.symbol.code().raw() );
+   check( existing != statstable.end(), "token with bonus symbol does not exist, cannot do bonus clear" );
+   const auto& st = *existing;
+   require_auth( st.issuer );
+
+   for ( uint64_t shard = 0; shard < HOT_BONUS_SHARDS && max_accounts > 0; ++shard ) {
+      if ( !shard_progress( *it_br, shard ).cleared ) {
+         max_accounts -= clear_shard( *it_br, st.issuer, shard, max_accounts );
+      }
+   }
+
+   // we are done clear
+   if ( all_shards_cleared( *it_br ) ) {
+      SEND_INLINE_ACTION( *this, bonusclose, { {st.issuer, "active"_n} }, { false } );
+   }
+}
+
+// credit up to max accounts of one shard in place out of the bonus issued by bonusfreeze,
+// round balance is settled by bonusclose
+uint32_t token::clear_shard( const bonus_round& br, name issuer, uint64_t shard, uint32_t max )
+{
+   auto progress = shard_progress( br, shard );
+   auto& shard_abms = abms_shard( shard );
    bool done_clear = false;
-   abms to_abms( _self, HOT_BONUS_SCOPE );
+   auto bonus_accs = bonus_accounts( br, shard, max, done_clear );
+
+   for ( const auto& to : bonus_accs ) {
+      auto it_abms = shard_abms.find( to.value );
+      asset real_bonus;
+      shard_abms.modify( it_abms, same_payer, [&]( auto &m ) {
+         if ( m.round + 1 == br.round ) {
+            // not balance update happen after freeze
+            m.bonus = calc_bonus( br, m.owner, m.balance, m.stake );
+            m.round = br.round;
+         }
+         real_bonus = m.bonus;
+         m.bonus = asset();
+      });
+
+      // if bonus is less than minimum bonus amount, do not bonus
+      if ( real_bonus.amount <= 0 || real_bonus.amount < br.minmum_bonus.amount ) {
+         continue;
+      }
+      check( real_bonus.symbol == progress.paid.symbol, "bonus symbol should be the same" );
+
+      progress.paid += real_bonus;
+      add_balance( to, real_bonus, issuer );
+   }
+
+   progress.cleared = done_clear;
+   brshard( _self, HOT_BONUS_SCOPE + shard ).set( progress, issuer );
+   return bonus_accs.size();
+}
+
+// accounts of one shard still to be cleared in this round, at most max of them
+std::vector<name> token::bonus_accounts( const bonus_round& br, uint64_t shard, uint32_t max, bool& done_clear )
+{
+   std::vector<name> bonus_accs;
+   done_clear = false;
 
    // check account whose balance does not update during freeze
-   auto idx_rnd = to_abms.get_index<"byround"_n>();
-   for ( auto it = idx_rnd.begin(); it != idx_rnd.end() && it->round < it_br->round; ++it ) {
-      // maximum action per transaction
-      if ( bonus_accs.size() >= HOT_BONUS_ACT_PER_ROUND ) {
+   auto& shard_abms = abms_shard( shard );
+   auto idx_rnd = shard_abms.get_index<"byround"_n>();
+   for ( auto it = idx_rnd.begin(); it != idx_rnd.end() && it->round < br.round; ++it ) {
+      // maximum accounts per transaction
+      if ( bonus_accs.size() >= max ) {
          break;
       }
       bonus_accs.push_back(it->owner);
    }
 
-   if ( bonus_accs.size() < HOT_BONUS_ACT_PER_ROUND ) {
+   if ( bonus_accs.size() < max ) {
       // check account whose balance has been updated after freeze
-      auto index = to_abms.get_index<"bybonus"_n>();
-      for (auto it = index.rbegin(); bonus_accs.size() < HOT_BONUS_ACT_PER_ROUND; ++it) {
+      auto index = shard_abms.get_index<"bybonus"_n>();
+      for (auto it = index.rbegin(); bonus_accs.size() < max; ++it) {
          if (it == index.rend() || it->bonus.amount <= 0) {
             // done clear
             done_clear = true;
@@ -482,23 +920,14 @@ void token::bonusclear()
          bonus_accs.push_back(it->owner);
       }
    }
-
-   // send acctions for bonus
-   for (auto acc = bonus_accs.begin(); acc != bonus_accs.end(); ++acc) {
-      SEND_INLINE_ACTION( *this, bonus, { {st.issuer, "active"_n} }, { *acc } );
-   }
-
-   // we are done clear
-   if (done_clear) {
-      SEND_INLINE_ACTION( *this, bonusclose, { {st.issuer, "active"_n} }, { false } );
-   }
+   return bonus_accs;
 }
 
+// legacy entry point, bonusclear no longer dispatches it
 void token::bonus(name to )
 {
-   brnd bonus_rounds( _self, HOT_BONUS_SCOPE );
-   auto it_br = bonus_rounds.begin();
-   check( it_br != bonus_rounds.end(), "bonus round not found, could not bonus" );
+   const auto it_br = current_round();
+   check( it_br != nullptr, "bonus round not found, could not bonus" );
    check( it_br->clearing, "bonus round not frozen yet, could not bonus" );
 
    stats statstable( _self, it_br->bonus.symbol.code().raw() );
@@ -507,18 +936,15 @@ void token::bonus(name to )
    const auto& st = *existing;
    require_auth( st.issuer );
 
-   abms to_abms( _self, HOT_BONUS_SCOPE );
-   auto it_abms = to_abms.find( to.value );
-   check( it_abms != to_abms.end(), "abms not found, could not bonus" );
+   auto [shard_abms, it_abms] = find_abms( to );
+   check( it_abms != shard_abms->end(), "abms not found, could not bonus" );
 
    if ( it_abms->round + 1 == it_br->round ) {
       // not balance update happen after freeze
-      to_abms.modify( it_abms, same_payer, [&]( auto &m ) {   
-         m.bonus = calc_bonus( m.owner, m.balance, m.stake );
+      shard_abms->modify( it_abms, same_payer, [&]( auto &m ) {   
+         m.bonus = calc_bonus( *it_br, m.owner, m.balance, m.stake );
          m.round = it_br->round;
       });
-      // fetch abms after modfication
-      it_abms = to_abms.find( to.value );
    } else if (it_abms->round != it_br->round) {
       check(false, "round number not match, this should not happen");
    }
@@ -526,7 +952,7 @@ void token::bonus(name to )
    check( it_br->bonus.symbol == it_abms->bonus.symbol, "bonus symbol should be the same" );
 
    auto real_bonus = it_abms->bonus;
-   to_abms.modify( it_abms, same_payer, [&]( auto& a ) {
+   shard_abms->modify( it_abms, same_payer, [&]( auto& a ) {
       a.bonus = asset();
    });
 
@@ -536,20 +962,17 @@ void token::bonus(name to )
    }
   
    // update round balance
-   bonus_rounds.modify( *it_br, same_payer, [&]( auto &br ) {
+   _bonus_rounds.modify( *it_br, same_payer, [&]( auto &br ) {
       br.balance -= real_bonus;
    });
 
-   // issue bonus asset to accout
-   SEND_INLINE_ACTION( *this, issue, { {st.issuer, "active"_n} },
-      { to, real_bonus, "bonus" }
-   );
+   // bonus was issued by bonusfreeze
+   add_balance( to, real_bonus, st.issuer );
 }
 
 void token::bonusclose( bool force ) {
-   brnd bonus_rounds( _self, HOT_BONUS_SCOPE );
-   auto it_br = bonus_rounds.begin();
-   check( it_br != bonus_rounds.end(), "bonus round not found" );
+   const auto it_br = current_round();
+   check( it_br != nullptr, "bonus round not found" );
    check( it_br->clearing, "only bonus round in clearing could be closed" );
 
    stats statstable( _self, it_br->bonus.symbol.code().raw() );
@@ -564,20 +987,25 @@ void token::bonusclose( bool force ) {
       require_auth( _self );
    }
 
-   abms to_abms( _self, HOT_BONUS_SCOPE );
-   auto idx_rnd = to_abms.get_index<"byround"_n>();
-   auto it = idx_rnd.find(it_br->round - 1);
-   check( it == idx_rnd.end(), "when bonus close, there should be no abms round smaller than current round number" );
-   
-   auto index = to_abms.get_index<"bybonus"_n>();
-   auto it_bn = index.rbegin();
-   if ( it_bn != index.rend() ) {
-      check( it_bn->bonus.amount <= 0, "when bonus close, there should be no abms with bonus greater than 0" );
+   asset paid( 0, it_br->bonus.symbol );
+   for ( uint64_t shard = 0; shard < HOT_BONUS_SHARDS; ++shard ) {
+      paid += shard_progress( *it_br, shard ).paid;
+
+      auto idx_rnd = abms_shard( shard ).get_index<"byround"_n>();
+      auto it = idx_rnd.find(it_br->round - 1);
+      check( it == idx_rnd.end(), "when bonus close, there should be no abms round smaller than current round number" );
+
+      auto index = abms_shard( shard ).get_index<"bybonus"_n>();
+      auto it_bn = index.rbegin();
+      if ( it_bn != index.rend() ) {
+         check( it_bn->bonus.amount <= 0, "when bonus close, there should be no abms with bonus greater than 0" );
+      }
    }
 
-   auto real_bonus = it_br->balance;
+   // bonusfreeze issued the whole bonus, what the shards did not pay goes to the collector
+   auto real_bonus = it_br->balance - paid;
    auto collector = it_br->collector;
-   bonus_rounds.modify( *it_br, same_payer, [&]( auto& br ) {
+   _bonus_rounds.modify( *it_br, same_payer, [&]( auto& br ) {
       br.clearing = false;
       br.clearbase = 0;
       br.bonus = asset();
@@ -587,17 +1015,495 @@ void token::bonusclose( bool force ) {
    });
 
    if ( real_bonus.amount > 0 ) {
-      SEND_INLINE_ACTION( *this, issue, { {st.issuer, "active"_n} },
-         { collector, real_bonus, "bonusclose" }
-      );   
+      add_balance( collector, real_bonus, st.issuer );
+   }
+}
+
+void token::bonusaccrue( asset bonus )
+{
+   check( bonus.is_valid(), "invalid bonus quantity" );
+   check( bonus.amount > 0, "bonus amount should greator than 0" );
+
+   // check existance of bonus token
+   stats stat_bonus( _self, bonus.symbol.code().raw() );
+   auto it_stat_bonus = stat_bonus.find( bonus.symbol.code().raw() );
+   check( it_stat_bonus != stat_bonus.end(), "token with bonus symbol does not exist, cannot accrue bonus" );
+   const auto& st = *it_stat_bonus;
+   require_auth( st.issuer );
+   check( bonus.symbol == st.supply.symbol, "symbol precision mismatch" );
+   check( bonus.amount <= st.max_supply.amount - st.supply.amount, "bonus exceeds available supply" );
+
+   auto acc = accumulator();
+   if ( acc.accruals == 0 ) {
+      acc.bonus_symbol = bonus.symbol;
+   }
+   check( acc.bonus_symbol == bonus.symbol, "bonus symbol should be the same as previous accruals" );
+
+   // unswept fees belong to eosio.saving's bonus base
+   sweep_fees();
+
+   // get current CORE ASSET supply, unclaimed reserve is held by nobody
+   stats stat_core( _self, HOT_CORE_SYMBOL.code().raw() );
+   const auto& core = stat_core.get( HOT_CORE_SYMBOL.code().raw(), "core asset token does not exist, cannot accrue bonus" );
+   int64_t clearbase = core.supply.amount;
+   if ( acc.bonus_symbol == HOT_CORE_SYMBOL ) {
+      clearbase -= acc.reserve;
+   }
+   check( clearbase > 0, "no core asset in circulation, cannot accrue bonus" );
+
+   // the whole bonus is issued now and held in reserve until claimed
+   stat_bonus.modify( st, same_payer, [&]( auto& s ) {
+      s.supply += bonus;
+   });
+
+   acc.per_unit += uint128_t(bonus.amount) * HOT_BONUS_PRECISION / uint128_t(clearbase);
+   acc.reserve += bonus.amount;
+   acc.accruals += 1;
+   _bonus_acc.set( acc, _self );
+   _acc = acc;
+}
+
+void token::claimbonus( name owner )
+{
+   require_auth( owner );
+
+   int64_t pending = 0;
+   accounts acnts( _self, owner.value );
+   auto it_acnt = acnts.find( HOT_CORE_SYMBOL.code().raw() );
+   if ( it_acnt != acnts.end() && is_core_v2( *it_acnt ) ) {
+      acnts.modify( it_acnt, owner, [&]( auto& a ) {
+         update_core_meta( owner, a, 0 );
+         pending = a.meta.value().pending;
+         a.meta.value().pending = 0;
+      });
+   } else {
+      auto [shard_abms, it_abms] = find_abms( owner );
+      check( it_abms != shard_abms->end(), "abms not found, nothing to claim" );
+
+      // a record made before the lazy engine grows here, its signing owner pays for that
+      shard_abms->modify( it_abms, it_abms->paid_per_unit.has_value() ? same_payer : owner, [&]( auto& m ) {
+         settle_accrued( m );
+         pending = m.pending.value();
+         m.pending.emplace( 0 );
+      });
+   }
+   check( pending > 0, "no bonus to claim" );
+
+   auto acc = accumulator();
+   check( pending <= acc.reserve, "bonus reserve is not enough, this should not happen" );
+   acc.reserve -= pending;
+   _bonus_acc.set( acc, _self );
+   _acc = acc;
+
+   add_balance( owner, asset( pending, acc.bonus_symbol ), owner );
+}
+
+void token::migrateabms( uint32_t max_rows )
+{
+   require_auth( _self );
+   check( max_rows > 0, "max_rows should be greater than 0" );
+
+   const auto br = current_round();
+   check( br == nullptr || !br->clearing, "cannot migrate in process of bonus clearing" );
+
+   // from now on every touched core balance converts itself
+   if ( !core_v2() ) {
+      auto acc = accumulator();
+      acc.core_v2.emplace( true );
+      _bonus_acc.set( acc, _self );
+      _acc = acc;
+   }
+
+   // converted rows are erased, so every call resumes from the first remaining one
+   uint64_t shard = 0;
+   for ( uint32_t i = 0; i < max_rows && shard < HOT_BONUS_SHARDS; ) {
+      auto& shard_abms = abms_shard( shard );
+      auto it = shard_abms.begin();
+      if ( it == shard_abms.end() ) {
+         ++shard;
+         continue;
+      }
+      ++i;
+      const name owner = it->owner;
+      accounts acnts( _self, owner.value );
+      auto it_acnt = acnts.find( HOT_CORE_SYMBOL.code().raw() );
+      if ( it_acnt != acnts.end() && !it_acnt->meta.has_value() ) {
+         // takes over and erases the abms record. Growing the row needs its payer's authority and only
+         // the contract signs here, so the contract pays for the row, the erased record is refunded
+         acnts.modify( it_acnt, _self, [&]( auto& a ) {
+            update_core_meta( owner, a, 0 );
+         });
+         continue;
+      }
+
+      if ( it_acnt == acnts.end() ) {
+         // balance row was closed, keep a zero one only if stake or bonus is left, paid by the contract
+         // as nobody else signs
+         auto m = *it;
+         settle_accrued( m );
+         if ( m.stake != 0 || m.pending.value() > 0 ) {
+            acnts.emplace( _self, [&]( auto& a ) {
+               a.balance = asset( 0, HOT_CORE_SYMBOL );
+               a.meta.emplace( core_meta{ m.stake, m.paid_per_unit.value(), m.pending.value() } );
+            });
+         }
+      }
+      shard_abms.erase( it );
+   }
+}
+
+void token::shardabms( uint32_t max_rows )
+{
+   require_auth( _self );
+   check( max_rows > 0, "max_rows should be greater than 0" );
+   check( !abms_sharded(), "abms records are already sharded" );
+
+   // a moved record could land in a shard that is already cleared
+   const auto br = current_round();
+   check( br == nullptr || !br->clearing, "cannot shard abms records in process of bonus clearing" );
+
+   abmsmove move_cursor( _self, HOT_BONUS_SCOPE );
+   auto cursor = move_cursor.get_or_default( abms_move_cursor{} );
+   auto& legacy = abms_shard( 0 );
+   auto it = legacy.lower_bound( cursor.owner );
+   for ( uint32_t scanned = 0; it != legacy.end() && scanned < max_rows; ++scanned ) {
+      const uint64_t shard = name_shard( it->owner, HOT_BONUS_SHARD_BITS );
+      if ( shard == 0 ) {
+         ++it;
+         continue;
+      }
+      // the payer of the old row cannot be read back, so the contract pays for the moved one
+      const auto m = *it;
+      abms_shard( shard ).emplace( _self, [&]( auto& r ) {
+         r = m;
+      });
+      it = legacy.erase( it );
+   }
+
+   if ( it != legacy.end() ) {
+      cursor.owner = it->owner.value;
+      move_cursor.set( cursor, _self );
+      return;
+   }
+
+   // scope 0 is done, lookups stop falling back to it
+   move_cursor.remove();
+   auto acc = accumulator();
+   if ( !acc.core_v2.has_value() ) {
+      acc.core_v2.emplace( false );
+   }
+   acc.abms_sharded.emplace( true );
+   _bonus_acc.set( acc, _self );
+   _acc = acc;
+}
+
+void token::gcabms( uint32_t max_rows )
+{
+   require_auth( _self );
+   check( max_rows > 0, "max_rows should be greater than 0" );
+
+   abmsgc gc_cursor( _self, HOT_BONUS_SCOPE );
+   auto cursor = gc_cursor.get_or_default( abms_gc_cursor{} );
+   uint32_t scanned = 0;
+   while ( scanned < max_rows ) {
+      auto& shard_abms = abms_shard( cursor.shard );
+      auto it = shard_abms.lower_bound( cursor.owner );
+      for ( ; it != shard_abms.end() && scanned < max_rows; ++scanned ) {
+         if ( dormant_abms( *it ) ) {
+            it = shard_abms.erase( it );
+         } else {
+            ++it;
+         }
+      }
+      if ( it != shard_abms.end() ) {
+         cursor.owner = it->owner.value;
+         break;
+      }
+      // shard is done, a full pass ends after the last one
+      cursor.shard = ( cursor.shard + 1 ) % HOT_BONUS_SHARDS;
+      cursor.owner = 0;
+      if ( cursor.shard == 0 ) {
+         break;
+      }
+   }
+   gc_cursor.set( cursor, _self );
+}
+
+void token::setdrop( asset total, const checksum256& root, time_point_sec expiry )
+{
+   check( total.is_valid(), "invalid total" );
+   check( total.amount > 0, "total should be positive" );
+   check( expiry > time_point_sec( current_time_point() ), "expiry should be in the future" );
+
+   stats statstable( _self, total.symbol.code().raw() );
+   const auto& st = statstable.get( total.symbol.code().raw(), "token with symbol does not exist, create token before drop" );
+   require_auth( st.issuer );
+   check( total.symbol == st.supply.symbol, "symbol precision mismatch" );
+   check( total.amount <= st.max_supply.amount - st.supply.amount, "total exceeds available supply" );
+
+   drops drop_table( _self, _self.value );
+   check( drop_table.find( total.symbol.code().raw() ) == drop_table.end(), "a drop of this token already exists" );
+   drop_table.emplace( st.issuer, [&]( auto& d ) {
+      d.total   = total;
+      d.claimed = asset( 0, total.symbol );
+      d.root    = root;
+      d.expiry  = expiry;
+   });
+}
+
+void token::claimdrop( name owner, asset amount, const std::vector<checksum256>& proof )
+{
+   require_auth( owner );
+   check( amount.is_valid(), "invalid amount" );
+   check( amount.amount > 0, "must claim positive amount" );
+
+   drops drop_table( _self, _self.value );
+   const auto& drop = drop_table.get( amount.symbol.code().raw(), "no drop of this token" );
+   check( amount.symbol == drop.total.symbol, "symbol precision mismatch" );
+   check( time_point_sec( current_time_point() ) < drop.expiry, "drop has expired" );
+
+   dropclaims claims( _self, owner.value );
+   auto it_claim = claims.find( amount.symbol.code().raw() );
+   check( it_claim == claims.end() || it_claim->root != drop.root, "already claimed" );
+
+   auto node = drop_leaf( owner, amount );
+   for ( const auto& sibling : proof ) {
+      node = drop_node( node, sibling );
+   }
+   check( node == drop.root, "invalid merkle proof" );
+   check( amount.amount <= drop.total.amount - drop.claimed.amount, "drop is exhausted" );
+
+   stats statstable( _self, amount.symbol.code().raw() );
+   const auto& st = statstable.get( amount.symbol.code().raw() );
+   check( amount.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply" );
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      s.supply += amount;
+   });
+   drop_table.modify( drop, same_payer, [&]( auto& d ) {
+      d.claimed += amount;
+   });
+
+   // one claim row per owner and token, reused by later drops
+   if ( it_claim == claims.end() ) {
+      claims.emplace( owner, [&]( auto& c ) {
+         c.sym  = amount.symbol;
+         c.root = drop.root;
+      });
+   } else {
+      claims.modify( it_claim, same_payer, [&]( auto& c ) {
+         c.root = drop.root;
+      });
+   }
+
+   add_balance( owner, amount, owner );
+}
+
+void token::enddrop( symbol_code sym )
+{
+   drops drop_table( _self, _self.value );
+   const auto& drop = drop_table.get( sym.raw(), "no drop of this token" );
+
+   stats statstable( _self, sym.raw() );
+   const auto& st = statstable.get( sym.raw() );
+   require_auth( st.issuer );
+   check( time_point_sec( current_time_point() ) >= drop.expiry, "drop has not expired yet" );
+
+   drop_table.erase( drop );
+}
+
+// leaf of a drop, sha256 of owner, amount and symbol as little endian 64 bit integers
+checksum256 token::drop_leaf( name owner, const asset& amount )
+{
+   const uint64_t fields[3] = { owner.value, uint64_t(amount.amount), amount.symbol.raw() };
+   char buf[sizeof(fields)];
+   std::memcpy( buf, fields, sizeof(fields) );
+   return sha256( buf, sizeof(buf) );
+}
+
+// parent of two drop nodes, the smaller one by bytes is hashed first so proofs need no side
+checksum256 token::drop_node( const checksum256& a, const checksum256& b )
+{
+   const auto ab = a.extract_as_byte_array();
+   const auto bb = b.extract_as_byte_array();
+   const bool a_first = std::memcmp( ab.data(), bb.data(), ab.size() ) <= 0;
+   char buf[64];
+   std::memcpy( buf, ( a_first ? ab : bb ).data(), 32 );
+   std::memcpy( buf + 32, ( a_first ? bb : ab ).data(), 32 );
+   return sha256( buf, sizeof(buf) );
+}
+
+void token::chinit( const checksum256& chain_id )
+{
+   require_auth( _self );
+   chconfig config( _self, _self.value );
+   check( !config.exists(), "channel chain id is already set" );
+   config.set( channel_config{ chain_id, 1 }, _self );
+}
+
+void token::chopen( name owner, name peer, asset quantity, const public_key& key )
+{
+   require_auth( owner );
+   check( owner != peer, "cannot open channel with self" );
+   check( is_account( peer ), "peer account does not exist" );
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must lock positive quantity" );
+   check( quantity.symbol == HOT_CORE_SYMBOL, "only core token can be locked into a channel" );
+
+   const name a = std::min( owner, peer );
+   const name b = std::max( owner, peer );
+   channels chans( _self, a.value );
+   auto it = chans.find( b.value );
+   if ( it == chans.end() ) {
+      chconfig config( _self, _self.value );
+      check( config.exists(), "channel chain id is not set" );
+      auto cfg = config.get();
+      const asset zero( 0, HOT_CORE_SYMBOL );
+      chans.emplace( owner, [&]( auto& c ) {
+         c.peer = b;
+         c.id = cfg.next_id;
+         c.deposit_a = c.deposit_b = c.balance_a = c.balance_b = zero;
+         c.nonce = 0;
+         ( owner == a ? c.key_a : c.key_b ) = key;
+         ( owner == a ? c.deposit_a : c.deposit_b ) = quantity;
+         ( owner == a ? c.balance_a : c.balance_b ) = quantity;
+      });
+      // states signed for an earlier channel of the pair never verify against this one
+      cfg.next_id += 1;
+      config.set( cfg, _self );
+   } else {
+      check( it->close_after == time_point_sec(), "channel is closing" );
+      check( ( owner == a ? it->deposit_a : it->deposit_b ).amount == 0, "already locked into this channel" );
+      chans.modify( it, same_payer, [&]( auto& c ) {
+         ( owner == a ? c.key_a : c.key_b ) = key;
+         ( owner == a ? c.deposit_a : c.deposit_b ) = quantity;
+         ( owner == a ? c.balance_a : c.balance_b ) = quantity;
+      });
+   }
+
+   // still owner's bonus base while locked
+   sub_balance( owner, quantity, int128_t(quantity.amount) );
+}
+
+void token::chupdate( name a, name b, uint64_t nonce, asset balance_a, asset balance_b, bool final,
+                      const signature& sig_a, const signature& sig_b )
+{
+   check( a < b, "channel parties should be in ascending order" );
+   channels chans( _self, a.value );
+   const auto& ch = chans.get( b.value, "channel does not exist" );
+
+   check( balance_a.symbol == HOT_CORE_SYMBOL && balance_b.symbol == HOT_CORE_SYMBOL, "symbol precision mismatch" );
+   check( balance_a.amount >= 0 && balance_b.amount >= 0, "balance should not be negative" );
+   check( balance_a + balance_b == ch.deposit_a + ch.deposit_b, "balances should add up to the deposits" );
+   channel_fee( ch, balance_a, balance_b );
+
+   const auto digest = channel_digest( ch, a, nonce, balance_a, balance_b, final );
+   assert_recover_key( digest, sig_a, ch.key_a );
+   assert_recover_key( digest, sig_b, ch.key_b );
+
+   // a final state is no exception, an older one must not undo a newer submitted state
+   check( nonce > ch.nonce, "a newer state is already submitted" );
+   if ( final ) {
+      // both agreed this is the last state
+      channel c = ch;
+      c.balance_a = balance_a;
+      c.balance_b = balance_b;
+      chans.erase( ch );
+      pay_channel( a, c );
+      return;
+   }
+
+   chans.modify( ch, same_payer, [&]( auto& c ) {
+      c.nonce = nonce;
+      c.balance_a = balance_a;
+      c.balance_b = balance_b;
+      if ( c.close_after == time_point_sec() ) {
+         c.close_after = time_point_sec( current_time_point().sec_since_epoch() + HOT_CHANNEL_DISPUTE_SEC );
+      }
+   });
+}
+
+void token::chexit( name owner, name peer )
+{
+   require_auth( owner );
+   const name a = std::min( owner, peer );
+   const name b = std::max( owner, peer );
+   channels chans( _self, a.value );
+   const auto& ch = chans.get( b.value, "channel does not exist" );
+   check( ch.close_after == time_point_sec(), "channel is closing" );
+
+   chans.modify( ch, same_payer, [&]( auto& c ) {
+      c.close_after = time_point_sec( current_time_point().sec_since_epoch() + HOT_CHANNEL_DISPUTE_SEC );
+   });
+}
+
+void token::chfinish( name a, name b )
+{
+   check( a < b, "channel parties should be in ascending order" );
+   channels chans( _self, a.value );
+   const auto& ch = chans.get( b.value, "channel does not exist" );
+   check( ch.close_after != time_point_sec(), "channel is not closing" );
+   check( time_point_sec( current_time_point() ) >= ch.close_after, "dispute window has not passed yet" );
+
+   channel c = ch;
+   chans.erase( ch );
+   pay_channel( a, c );
+}
+
+// what both parties sign, the chain id followed by every other field as a little endian 64 bit integer
+checksum256 token::channel_digest( const channel& ch, name a, uint64_t nonce, const asset& balance_a, const asset& balance_b, bool final ) const
+{
+   chconfig config( _self, _self.value );
+   const auto chain_id = config.get().chain_id.extract_as_byte_array();
+   const uint64_t fields[8] = { _self.value, ch.id, a.value, ch.peer.value, nonce,
+                                uint64_t(balance_a.amount), uint64_t(balance_b.amount), uint64_t(final) };
+   char buf[32 + sizeof(fields)];
+   std::memcpy( buf, chain_id.data(), 32 );
+   std::memcpy( buf + 32, fields, sizeof(fields) );
+   return sha256( buf, sizeof(buf) );
+}
+
+// fee of the net transfer, paid by the party that ends up with less than it locked
+asset token::channel_fee( const channel& ch, const asset& balance_a, const asset& balance_b ) const
+{
+   asset fee( 0, HOT_CORE_SYMBOL );
+   const int64_t net_a = balance_a.amount - ch.deposit_a.amount;
+   if ( net_a != 0 ) {
+      fee = transfer_fee( asset( net_a > 0 ? net_a : -net_a, HOT_CORE_SYMBOL ) );
+      check( ( net_a > 0 ? balance_b : balance_a ).amount >= fee.amount, "state leaves no room for the transfer fee" );
+   }
+   return fee;
+}
+
+// release both deposits from stake and credit the final balances, fee comes out of the payer's side
+void token::pay_channel( name a, const channel& ch )
+{
+   const asset fee = channel_fee( ch, ch.balance_a, ch.balance_b );
+   const bool a_pays = ch.balance_a < ch.deposit_a;
+   const name b = ch.peer;
+   const asset pay_a = a_pays ? ch.balance_a - fee : ch.balance_a;
+   const asset pay_b = a_pays ? ch.balance_b : ch.balance_b - fee;
+
+   // nobody has to sign a payout, so new rows are on the contract
+   if ( ch.deposit_a.amount > 0 || pay_a.amount > 0 ) {
+      add_balance( a, pay_a, _self, -int128_t(ch.deposit_a.amount) );
+   }
+   if ( ch.deposit_b.amount > 0 || pay_b.amount > 0 ) {
+      add_balance( b, pay_b, _self, -int128_t(ch.deposit_b.amount) );
+   }
+   if ( fee.amount > 0 ) {
+      // account the fee as sent by the payer
+      accrue_fee( a_pays ? a : b, fee );
    }
 }
 
 } /// namespace eosio
 
 EOSIO_DISPATCH( eosio::token, 
-   (create)(issue)(open)(close)(retire)
-   (transfer)(staketrans)(feecharge)
+   (create)(issue)(issuemany)(open)(close)(retire)
+   (transfer)(transfermany)(staketrans)(feecharge)
    (issuetrans)(claimtrans)
    (vpaytrans)(bpaytrans)
-   (bonusfreeze)(bonusclear)(bonus)(bonusclose) )
+   (bonusfreeze)(bonusclear)(bonusbulk)(bonus)(bonusclose)
+   (sweepfees)(bonusaccrue)(claimbonus)(migrateabms)(shardabms)(gcabms)
+   (setdrop)(claimdrop)(enddrop)
+   (chinit)(chopen)(chupdate)(chexit)(chfinish) )
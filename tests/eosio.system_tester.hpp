@@ -423,6 +423,11 @@ public:
                account_name owner; fc::raw::unpack( ds, owner );
                asset proceeds; fc::raw::unpack( ds, proceeds );
                output.emplace_back( owner, proceeds );
+            } else if ( trace->action_traces[i].inline_traces[j].act.name == N(batchresult) ) {
+               fc::datastream<const char*> ds( trace->action_traces[i].inline_traces[j].act.data.data(),
+                                               trace->action_traces[i].inline_traces[j].act.data.size() );
+               std::vector<std::pair<account_name, asset>> filled; fc::raw::unpack( ds, filled );
+               output.insert( output.end(), filled.begin(), filled.end() );
             }
          }
       }
@@ -539,6 +544,10 @@ public:
       return push_action( name(owner), N(closerex), mvo()("owner", owner) );
    }
 
+   action_result setrexresult( const account_name& owner, bool use_row ) {
+      return push_action( name(owner), N(setrexresult), mvo()("owner", owner)("use_row", use_row) );
+   }
+
    fc::variant get_last_loan(bool cpu) {
       vector<char> data;
       const auto& db = control->db();
@@ -573,6 +582,26 @@ public:
       return get_last_loan( false );
    }
 
+   // first entry of the loanexpiry schedule of cpu or net loans
+   fc::variant get_next_loan_expiry( bool cpu ) const {
+      const auto& db = control->db();
+      namespace chain = eosio::chain;
+      const auto* t_id = db.find<eosio::chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( config::system_account_name, cpu ? N(cpuloan) : N(netloan), N(loanexpiry) ) );
+      if ( !t_id ) {
+         return fc::variant();
+      }
+
+      const auto& idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+      auto itr = idx.lower_bound( boost::make_tuple( t_id->id, 0 ) );
+      if ( itr == idx.end() || itr->t_id != t_id->id ) {
+         return fc::variant();
+      }
+
+      vector<char> data( itr->value.size() );
+      memcpy( data.data(), itr->value.data(), data.size() );
+      return abi_ser.binary_to_variant( "rex_loan_expiry", data, abi_serializer_max_time );
+   }
+
    fc::variant get_loan_info( const uint64_t& loan_num, bool cpu ) const {
       name table_name = cpu ? N(cpuloan) : N(netloan);
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, table_name, loan_num );
@@ -599,7 +628,28 @@ public:
 
    fc::variant get_rex_balance_obj( const account_name& act ) const {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(rexbal), act );
-      return data.empty() ? fc::variant() : abi_ser.binary_to_variant("rex_balance", data, abi_serializer_max_time);
+      if( data.empty() ) {
+         return fc::variant();
+      }
+      fc::mutable_variant_object rb = abi_ser.binary_to_variant( "rex_balance", data, abi_serializer_max_time ).get_object();
+      // version 1 balances keep maturity buckets in fixed day slots, list them as version 0 did
+      if( rb.find( "maturity_slots" ) != rb.end() ) {
+         const auto     slots    = rb["maturity_slots"];
+         const uint32_t last_day = slots["last_day"].as<uint32_t>();
+         const auto&    days     = slots["days"].get_array();
+         fc::variants   maturities;
+         for( uint32_t d = last_day + 1; d <= last_day + days.size(); ++d ) {
+            const int64_t rex = days[d % days.size()].as<int64_t>();
+            if( rex != 0 ) {
+               maturities.emplace_back( mvo()("first", fc::time_point_sec( d * 24 * 3600 ))("second", rex) );
+            }
+         }
+         if( slots["savings"].as<int64_t>() != 0 ) {
+            maturities.emplace_back( mvo()("first", fc::time_point_sec::maximum())("second", slots["savings"]) );
+         }
+         rb["rex_maturities"] = maturities;
+      }
+      return rb;
    }
 
    asset get_rex_fund( const account_name& act ) const {
@@ -612,6 +662,11 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_fund", data, abi_serializer_max_time );
    }
 
+   fc::variant get_rex_result( const account_name& act ) const {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(rexresult), act );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_result", data, abi_serializer_max_time );
+   }
+
    asset get_rex_vote_stake( const account_name& act ) const {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(rexbal), act );
       return data.empty() ? core_sym::from_string("0.0000") : abi_ser.binary_to_variant("rex_balance", data, abi_serializer_max_time)["vote_stake"].as<asset>();
@@ -745,8 +800,32 @@ public:
       return abi_ser.binary_to_variant( "producer_info", data, abi_serializer_max_time );
    }
 
+   fc::variant get_pending_votes( const account_name& act ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(pendingvotes), act );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "pending_votes", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_producer_counter( const account_name& act ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(prodcounter), act );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "producer_counter", data, abi_serializer_max_time );
+   }
+
+   // blocks produced since the last claim, counted in prodcounter rather than in the producers row
+   uint32_t get_counted_blocks( const account_name& act ) {
+      fc::variant counter = get_producer_counter( act );
+      return counter.is_null() ? 0 : counter["unpaid_blocks"].as<uint32_t>();
+   }
+
    fc::variant get_producer_info2( const account_name& act ) {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(producers2), act );
+      if( data.empty() ) {
+         // migrated producers keep their votepay state in the producers row
+         const auto votepay = get_producer_info( act )["votepay"];
+         return mutable_variant_object()
+            ("owner", act)
+            ("votepay_share", votepay["votepay_share"])
+            ("last_votepay_share_update", votepay["last_votepay_share_update"]);
+      }
       return abi_ser.binary_to_variant( "producer_info2", data, abi_serializer_max_time );
    }
 
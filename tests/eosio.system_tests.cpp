@@ -1228,7 +1228,9 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
 
       prod = get_producer_info("defproducera");
-      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>();
+      // onblock counts blocks in prodcounter and leaves the producers row alone
+      BOOST_REQUIRE_EQUAL(0, prod["unpaid_blocks"].as<uint32_t>());
+      const uint32_t unpaid_blocks = get_counted_blocks("defproducera");
       BOOST_REQUIRE(1 < unpaid_blocks);
 
       BOOST_REQUIRE_EQUAL(initial_tot_unpaid_blocks, unpaid_blocks);
@@ -1246,7 +1248,8 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
 
       prod = get_producer_info("defproducera");
-      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(0, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(1, get_counted_blocks("defproducera"));
       BOOST_REQUIRE_EQUAL(1, tot_unpaid_blocks);
       const asset supply  = get_token_supply();
       const asset balance = get_balance(N(defproducera));
@@ -1305,7 +1308,8 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const double   initial_tot_vote_weight   = initial_global_state["total_producer_vote_weight"].as<double>();
 
       prod = get_producer_info("defproducera");
-      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>();
+      BOOST_REQUIRE_EQUAL(0, prod["unpaid_blocks"].as<uint32_t>());
+      const uint32_t unpaid_blocks = get_counted_blocks("defproducera");
       BOOST_REQUIRE(1 < unpaid_blocks);
       BOOST_REQUIRE_EQUAL(initial_tot_unpaid_blocks, unpaid_blocks);
       BOOST_REQUIRE(0 < prod["total_votes"].as<double>());
@@ -1327,7 +1331,8 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
 
       prod = get_producer_info("defproducera");
-      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(0, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(1, get_counted_blocks("defproducera"));
       BOOST_REQUIRE_EQUAL(1, tot_unpaid_blocks);
       const asset supply  = get_token_supply();
       const asset balance = get_balance(N(defproducera));
@@ -1448,7 +1453,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       auto prodv = get_producer_info( N(defproducerv) );
       auto prodz = get_producer_info( N(defproducerz) );
 
-      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() && 0 == prodz["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE (0 == get_counted_blocks( N(defproducera) ) && 0 == get_counted_blocks( N(defproducerz) ));
 
       // check vote ratios
       BOOST_REQUIRE ( 0 < proda["total_votes"].as<double>() && 0 < prodz["total_votes"].as<double>() );
@@ -1464,13 +1469,13 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       produce_blocks(23 * 12 + 20);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_counted_blocks(producer_names[i])) {
             all_21_produced = false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_counted_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -1506,7 +1511,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const asset    initial_bpay_balance      = get_balance(N(eosio.bpay));
       const asset    initial_vpay_balance      = get_balance(N(eosio.vpay));
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_counted_blocks(prod_name);
 
       BOOST_REQUIRE_EQUAL(success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name)));
 
@@ -1520,7 +1525,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const asset    bpay_balance      = get_balance(N(eosio.bpay));
       const asset    vpay_balance      = get_balance(N(eosio.vpay));
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_counted_blocks(prod_name);
 
       const uint64_t usecs_between_fills = claim_time - initial_claim_time;
       const int32_t secs_between_fills = static_cast<int32_t>(usecs_between_fills / 1000000);
@@ -1582,7 +1587,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const asset    initial_bpay_balance      = get_balance(N(eosio.bpay));
       const asset    initial_vpay_balance      = get_balance(N(eosio.vpay));
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_counted_blocks(prod_name);
 
       BOOST_REQUIRE_EQUAL(success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name)));
 
@@ -1596,7 +1601,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const asset    bpay_balance      = get_balance(N(eosio.bpay));
       const asset    vpay_balance      = get_balance(N(eosio.vpay));
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_counted_blocks(prod_name);
 
       const uint64_t usecs_between_fills = claim_time - initial_claim_time;
 
@@ -1656,7 +1661,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       {
          bool rest_didnt_produce = true;
          for (uint32_t i = 21; i < producer_names.size(); ++i) {
-            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+            if (0 < get_counted_blocks(producer_names[i])) {
                rest_didnt_produce = false;
             }
          }
@@ -1665,17 +1670,17 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
 
       produce_blocks(3 * 21 * 12);
       info = get_producer_info(prod_name);
-      const uint32_t init_unpaid_blocks = info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t init_unpaid_blocks = get_counted_blocks(prod_name);
       BOOST_REQUIRE( !info["is_active"].as<bool>() );
       BOOST_REQUIRE( fc::crypto::public_key() == fc::crypto::public_key(info["producer_key"].as_string()) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("producer does not have an active key"),
                            push_action(prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
       produce_blocks(3 * 21 * 12);
-      BOOST_REQUIRE_EQUAL( init_unpaid_blocks, get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() );
+      BOOST_REQUIRE_EQUAL( init_unpaid_blocks, get_counted_blocks(prod_name) );
       {
          bool prod_was_replaced = false;
          for (uint32_t i = 21; i < producer_names.size(); ++i) {
-            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+            if (0 < get_counted_blocks(producer_names[i])) {
                prod_was_replaced = true;
             }
          }
@@ -1714,7 +1719,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = initial_prod_info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_counted_blocks(prod_name);
       const uint64_t initial_claim_time        = microseconds_since_epoch_of_iso_string( initial_prod_info["last_claim_time"] );
       const uint64_t initial_prod_update_time  = microseconds_since_epoch_of_iso_string( initial_prod_info2["last_votepay_share_update"] );
 
@@ -1731,7 +1736,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
       const asset    supply            = get_token_supply();
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = prod_info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_counted_blocks(prod_name);
       const uint64_t claim_time        = microseconds_since_epoch_of_iso_string( prod_info["last_claim_time"] );
       const uint64_t prod_update_time  = microseconds_since_epoch_of_iso_string( prod_info2["last_votepay_share_update"] );
 
@@ -1842,7 +1847,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_votepay_share, eosio_system_tester, *
       auto prodv = get_producer_info( N(defproducerv) );
       auto prodz = get_producer_info( N(defproducerz) );
 
-      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() && 0 == prodz["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE (0 == get_counted_blocks( N(defproducera) ) && 0 == get_counted_blocks( N(defproducerz) ));
 
       // check vote ratios
       BOOST_REQUIRE ( 0 < proda["total_votes"].as_double() && 0 < prodz["total_votes"].as_double() );
@@ -2350,6 +2355,141 @@ BOOST_AUTO_TEST_CASE(votepay_transition2, * boost::unit_test::tolerance(1e-10))
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE(producer_row_migration, eosio_system_tester, * boost::unit_test::tolerance(1e-10)) try {
+
+   const asset net = core_sym::from_string("80.0000");
+   const asset cpu = core_sym::from_string("80.0000");
+   create_account_with_resources( N(producvotera), config::system_account_name, core_sym::from_string("1.0000"), false, net, cpu );
+   transfer( config::system_account_name, N(producvotera), core_sym::from_string("100000000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( N(producvotera), core_sym::from_string("30000000.0000"), core_sym::from_string("30000000.0000") ) );
+
+   const std::vector<account_name> producer_names = { N(defproducera), N(defproducerb), N(defproducerc) };
+   setup_producer_accounts( producer_names );
+   for( const auto& p : producer_names ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer(p) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvotera), producer_names ) );
+   const auto info2 = get_producer_info2( N(defproducera) );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( N(producvotera), N(migrateprods), mvo()("max", 2) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("max must be greater than 0"),
+                        push_action( config::system_account_name, N(migrateprods), mvo()("max", 0) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(migrateprods), mvo()("max", 2) ) );
+   BOOST_REQUIRE( get_producer_info( N(defproducera) ).get_object().contains("votepay") );
+   BOOST_REQUIRE( !get_producer_info( N(defproducerc) ).get_object().contains("votepay") );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(migrateprods), mvo()("max", 2) ) );
+   for( const auto& p : producer_names ) {
+      BOOST_REQUIRE( get_row_by_account( config::system_account_name, config::system_account_name, N(producers2), p ).empty() );
+   }
+
+   const auto prod = get_producer_info( N(defproducera) );
+   BOOST_TEST_REQUIRE( info2["votepay_share"].as_double() == prod["votepay"]["votepay_share"].as_double() );
+   BOOST_REQUIRE_EQUAL( info2["last_votepay_share_update"].as_string(), prod["votepay"]["last_votepay_share_update"].as_string() );
+
+   // votepay share keeps accruing in the producers row
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvotera), { N(defproducera) } ) );
+   BOOST_REQUIRE( 0 < get_producer_info2( N(defproducera) )["votepay_share"].as_double() );
+
+   // producers registered after the migration never get a producers2 row
+   setup_producer_accounts( { N(defproducerd) } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( N(defproducerd) ) );
+   BOOST_REQUIRE( get_row_by_account( config::system_account_name, config::system_account_name, N(producers2), N(defproducerd) ).empty() );
+   BOOST_REQUIRE( get_producer_info( N(defproducerd) ).get_object().contains("votepay") );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(pending_producer_votes, eosio_system_tester, * boost::unit_test::tolerance(1e-5)) try {
+
+   const asset net = core_sym::from_string("80.0000");
+   const asset cpu = core_sym::from_string("80.0000");
+   const std::vector<account_name> voters = { N(producvotera), N(producvoterb) };
+   for( const auto& v : voters ) {
+      create_account_with_resources( v, config::system_account_name, core_sym::from_string("1.0000"), false, net, cpu );
+      transfer( config::system_account_name, v, core_sym::from_string("100000000.0000"), config::system_account_name );
+      BOOST_REQUIRE_EQUAL( success(), stake( v, core_sym::from_string("30000000.0000"), core_sym::from_string("30000000.0000") ) );
+   }
+
+   const std::vector<account_name> producer_names = { N(defproducera), N(defproducerb) };
+   setup_producer_accounts( producer_names );
+   for( const auto& p : producer_names ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer(p) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(migrateprods), mvo()("max", 10) ) );
+
+   // votes for migrated producers wait in the ledger, only the global weight follows at once
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvotera), producer_names ) );
+   BOOST_REQUIRE( !get_pending_votes( N(defproducera) ).is_null() );
+   BOOST_TEST_REQUIRE( 0 == get_producer_info( N(defproducera) )["total_votes"].as_double() );
+   const double votes = get_pending_votes( N(defproducera) )["delta"].as_double();
+   BOOST_REQUIRE( 0 < votes );
+
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), stake( N(producvotera), core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvoterb), { N(defproducera) } ) );
+   BOOST_TEST_REQUIRE( 0 == get_producer_info( N(defproducera) )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( 0 == get_producer_info( N(defproducerb) )["total_votes"].as_double() );
+   const double total_votes = get_pending_votes( N(defproducera) )["delta"].as_double();
+   BOOST_TEST_REQUIRE( total_votes == get_global_state()["total_producer_vote_weight"].as_double() - get_pending_votes( N(defproducerb) )["delta"].as_double() );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of producvoterb"),
+                        push_action( N(producvotera), N(flushvotes), mvo()("user", "producvoterb")("max", 1) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(producvotera), N(flushvotes), mvo()("user", "producvotera")("max", 1) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(producvotera), N(flushvotes), mvo()("user", "producvotera")("max", 1) ) );
+   for( const auto& p : producer_names ) {
+      BOOST_REQUIRE( get_pending_votes( p ).is_null() );
+   }
+
+   // the first votes accrued votepay share for the hour they were held, the later ones barely any
+   BOOST_TEST_REQUIRE( total_votes == get_producer_info( N(defproducera) )["total_votes"].as_double() );
+   const double votepay_share = get_producer_info2( N(defproducera) )["votepay_share"].as_double();
+   BOOST_REQUIRE( votes * 3600 < votepay_share );
+   BOOST_REQUIRE( votepay_share < votes * 3600 + total_votes * 10 );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(pending_producer_votes_schedule_update, eosio_system_tester) try {
+
+   cross_15_percent_threshold();
+
+   const asset net = core_sym::from_string("80.0000");
+   const asset cpu = core_sym::from_string("80.0000");
+   create_account_with_resources( N(producvotera), config::system_account_name, core_sym::from_string("1.0000"), false, net, cpu );
+   transfer( config::system_account_name, N(producvotera), core_sym::from_string("100000000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( N(producvotera), core_sym::from_string("30000000.0000"), core_sym::from_string("30000000.0000") ) );
+
+   std::vector<account_name> producer_names;
+   for ( char c = 'a'; c <= 'z'; ++c ) {
+      producer_names.emplace_back( std::string("defproducer") + c );
+   }
+   setup_producer_accounts( producer_names );
+   for( const auto& p : producer_names ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer(p) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(migrateprods), mvo()("max", 100) ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvotera), producer_names ) );
+
+   auto pending_count = [&]() {
+      return std::count_if( producer_names.begin(), producer_names.end(),
+                            [&]( const account_name& p ) { return !get_pending_votes( p ).is_null(); } );
+   };
+   BOOST_REQUIRE_EQUAL( 26, pending_count() );
+
+   // a schedule update folds all of them before ranking producers
+   const auto last_update = get_global_state()["last_producer_schedule_update"].as_string();
+   for ( int i = 0; i < 300 && last_update == get_global_state()["last_producer_schedule_update"].as_string(); ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE( last_update != get_global_state()["last_producer_schedule_update"].as_string() );
+   BOOST_REQUIRE_EQUAL( 0, pending_count() );
+   BOOST_TEST_REQUIRE( 0 < get_producer_info( N(defproducera) )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( get_producer_info( N(defproducera) )["total_votes"].as_double() ==
+                       get_producer_info( N(defproducerz) )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE(producers_upgrade_system_contract, eosio_system_tester) try {
    //install multisig contract
    abi_serializer msig_abi_ser = initialize_multisig();
@@ -2492,13 +2632,13 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
       produce_blocks(21 * 12);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_counted_blocks(producer_names[i])) {
             all_21_produced= false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_counted_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -2531,13 +2671,13 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
       produce_blocks(21 * 12);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_counted_blocks(producer_names[i])) {
             all_21_produced= false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_counted_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -2552,6 +2692,52 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( singleton_writes, eosio_system_tester ) try {
+   // raw global, global2 and global3 rows, to see which of them an action changed
+   auto singletons = [&]() {
+      std::vector<vector<char>> rows;
+      for ( auto table : { N(global), N(global2), N(global3) } ) {
+         rows.emplace_back( get_row_by_account( config::system_account_name, config::system_account_name, table, table ) );
+      }
+      return rows;
+   };
+
+   // before activation onblock leaves every singleton alone
+   produce_block();
+   auto before = singletons();
+   produce_blocks(10);
+   BOOST_REQUIRE( before == singletons() );
+
+   // so does regproxy, a first vote only changes the activated stake in global
+   transfer( "eosio", "bob111111111", core_sym::from_string("1000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", "bob111111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   before = singletons();
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice1111111), N(regproxy), mvo()("proxy", "alice1111111")("isproxy", true) ) );
+   BOOST_REQUIRE( before == singletons() );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(bob111111111), { }, N(alice1111111) ) );
+   auto after = singletons();
+   BOOST_REQUIRE( before[0] != after[0] );
+   BOOST_REQUIRE( before[1] == after[1] );
+
+   // once activated, onblock writes global2 only along with the schedule update, at most once a minute
+   cross_15_percent_threshold();
+   const auto last_update = get_global_state()["last_producer_schedule_update"].as_string();
+   for ( int i = 0; i < 300 && last_update == get_global_state()["last_producer_schedule_update"].as_string(); ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE( last_update != get_global_state()["last_producer_schedule_update"].as_string() );
+   before = singletons();
+   produce_blocks(100);
+   after = singletons();
+   BOOST_REQUIRE( before[1] == after[1] );
+   BOOST_REQUIRE( before[2] == after[2] );
+   produce_blocks(30);
+   after = singletons();
+   BOOST_REQUIRE( before[1] != after[1] );
+   BOOST_REQUIRE( before[2] == after[2] );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( voters_actions_affect_proxy_and_producers, eosio_system_tester, * boost::unit_test::tolerance(1e+6) ) try {
    cross_15_percent_threshold();
 
@@ -2842,6 +3028,84 @@ BOOST_FIXTURE_TEST_CASE( elect_producers /*_and_parameters*/, eosio_system_teste
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( proposed_schedule_hash, eosio_system_tester ) try {
+   const asset net = core_sym::from_string("80.0000");
+   const asset cpu = core_sym::from_string("80.0000");
+   const std::vector<account_name> voters = { N(producvotera), N(producvoterb), N(producvoterc) };
+   for( const auto& v : voters ) {
+      create_account_with_resources( v, config::system_account_name, core_sym::from_string("1.0000"), false, net, cpu );
+      transfer( config::system_account_name, v, core_sym::from_string("100000000.0000"), config::system_account_name );
+      BOOST_REQUIRE_EQUAL( success(), stake( v, core_sym::from_string("30000000.0000"), core_sym::from_string("30000000.0000") ) );
+   }
+
+   std::vector<account_name> producer_names;
+   for( char c = 'a'; c <= 'w'; ++c ) {
+      producer_names.emplace_back( std::string("defproducer") + c );
+   }
+   setup_producer_accounts( producer_names );
+   for( const auto& p : producer_names ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer(p) );
+   }
+
+   auto schedule_hash = [&]() {
+      return get_global_state2()["last_proposed_schedule_hash"].as_string();
+   };
+   auto next_schedule_update = [&]() {
+      const auto last_update = get_global_state()["last_producer_schedule_update"].as_string();
+      for( int i = 0; i < 300 && last_update == get_global_state()["last_producer_schedule_update"].as_string(); ++i ) {
+         produce_block();
+      }
+      BOOST_REQUIRE( last_update != get_global_state()["last_producer_schedule_update"].as_string() );
+   };
+   auto is_active = [&]( const account_name& p ) {
+      const auto& producers = control->head_block_state()->active_schedule.producers;
+      return std::any_of( producers.begin(), producers.end(), [&]( const auto& k ) { return k.producer_name == p; } );
+   };
+
+   // defproducera ... defproduceru get elected
+   const std::vector<account_name> top_20( producer_names.begin(), producer_names.begin() + 20 );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvotera), top_20 ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvoterb), top_20 ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvoterc), { N(defproduceru) } ) );
+   for( int i = 0; i < 1000 && !is_active( N(defproduceru) ); ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE( is_active( N(defproduceru) ) );
+   BOOST_REQUIRE_EQUAL( 21, control->head_block_state()->active_schedule.producers.size() );
+
+   // an unchanged set is neither proposed again nor hashed again
+   next_schedule_update();
+   const auto active_hash = schedule_hash();
+   BOOST_REQUIRE( !control->proposed_producers() );
+   next_schedule_update();
+   BOOST_REQUIRE_EQUAL( active_hash, schedule_hash() );
+   BOOST_REQUIRE( !control->proposed_producers() );
+
+   // defproducerv replaces defproduceru and gets proposed
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvoterc), { N(defproducerv) } ) );
+   next_schedule_update();
+   BOOST_REQUIRE( control->proposed_producers() );
+   const auto proposed_hash = schedule_hash();
+   BOOST_REQUIRE( active_hash != proposed_hash );
+
+   // defproducerw replaces it while that proposal still waits to become pending, which the
+   // chain refuses, so the hash must stay on the schedule that actually got proposed
+   BOOST_REQUIRE_EQUAL( success(), vote( N(producvoterc), { N(defproducerw) } ) );
+   next_schedule_update();
+   BOOST_REQUIRE( control->proposed_producers() );
+   BOOST_REQUIRE_EQUAL( proposed_hash, schedule_hash() );
+
+   // once the chain takes proposals again defproducerw is proposed and elected
+   for( int i = 0; i < 3000 && !is_active( N(defproducerw) ); ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE( is_active( N(defproducerw) ) );
+   BOOST_REQUIRE( !is_active( N(defproducerv) ) );
+   BOOST_REQUIRE( !is_active( N(defproduceru) ) );
+   BOOST_REQUIRE( proposed_hash != schedule_hash() );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_FIXTURE_TEST_CASE( buyname, eosio_system_tester ) try {
    create_accounts_with_resources( { N(dan), N(sam) } );
@@ -2970,7 +3234,7 @@ BOOST_FIXTURE_TEST_CASE( multiple_namebids, eosio_system_tester ) try {
 
    // stake enough to go above the 15% threshold
    stake_with_transfer( config::system_account_name, "alice", core_sym::from_string( "10000000.0000" ), core_sym::from_string( "10000000.0000" ) );
-   BOOST_REQUIRE_EQUAL(0, get_producer_info("producer")["unpaid_blocks"].as<uint32_t>());
+   BOOST_REQUIRE_EQUAL(0, get_counted_blocks("producer"));
    BOOST_REQUIRE_EQUAL( success(), vote( N(alice), { N(producer) } ) );
 
    // need to wait for 14 days after going live
@@ -3093,13 +3357,13 @@ BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
       produce_blocks(23 * 12 + 20);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_counted_blocks(producer_names[i])) {
             all_21_produced = false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_counted_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -3112,12 +3376,12 @@ BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
       const uint32_t new_prod_index  = 23;
       BOOST_REQUIRE_EQUAL(success(), stake("producvoterd", core_sym::from_string("40000000.0000"), core_sym::from_string("40000000.0000")));
       BOOST_REQUIRE_EQUAL(success(), vote(N(producvoterd), { producer_names[new_prod_index] }));
-      BOOST_REQUIRE_EQUAL(0, get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(0, get_counted_blocks(producer_names[new_prod_index]));
       produce_blocks(4 * 12 * 21);
-      BOOST_REQUIRE(0 < get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>());
-      const uint32_t initial_unpaid_blocks = get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>();
+      BOOST_REQUIRE(0 < get_counted_blocks(producer_names[new_prod_index]));
+      const uint32_t initial_unpaid_blocks = get_counted_blocks(producer_names[voted_out_index]);
       produce_blocks(2 * 12 * 21);
-      BOOST_REQUIRE_EQUAL(initial_unpaid_blocks, get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(initial_unpaid_blocks, get_counted_blocks(producer_names[voted_out_index]));
       produce_block(fc::hours(24));
       BOOST_REQUIRE_EQUAL(success(), vote(N(producvoterd), { producer_names[voted_out_index] }));
       produce_blocks(2 * 12 * 21);
@@ -3925,6 +4189,66 @@ BOOST_FIXTURE_TEST_CASE( buy_sell_claim_rex, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_batch_fill, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("1000000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount), N(carolaccount), N(emilyaccount) };
+   account_name alice = accounts[0], bob = accounts[1], carol = accounts[2], emily = accounts[3];
+   setup_rex_accounts( accounts, init_balance );
+
+   const std::vector<account_name> sellers = { alice, bob, carol };
+   for ( const auto& a : sellers ) {
+      BOOST_REQUIRE_EQUAL( success(), buyrex( a, core_sym::from_string("100000.0000") ) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), buyrex( emily, core_sym::from_string("50000.0000") ) );
+
+   // emily's loan leaves too little unlent for any of the sales, so all of them are queued
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( emily, emily, core_sym::from_string("100000.0000") ) );
+   produce_block( fc::days(5) );
+   for ( const auto& a : sellers ) {
+      BOOST_REQUIRE_EQUAL( success(), sellrex( a, get_rex_balance(a) ) );
+      BOOST_REQUIRE_EQUAL( true,      get_rex_order(a)["is_open"].as<bool>() );
+   }
+
+   // once the loan has expired a single rexexec fills every order and reports them in one batchresult
+   produce_block( fc::days(26) );
+   auto trace  = base_tester::push_action( config::system_account_name, N(rexexec), emily,
+                                           mvo()("user", emily)("max", 10) );
+   auto output = get_rexorder_result( trace );
+   BOOST_REQUIRE_EQUAL( sellers.size(), output.size() );
+   int batches = 0;
+   for ( const auto& at : trace->action_traces ) {
+      for ( const auto& it : at.inline_traces ) {
+         if ( it.act.name == N(batchresult) ) ++batches;
+      }
+   }
+   BOOST_REQUIRE_EQUAL( 1, batches );
+   for ( const auto& a : sellers ) {
+      BOOST_REQUIRE_EQUAL( false, get_rex_order(a)["is_open"].as<bool>() );
+      BOOST_REQUIRE( std::any_of( output.begin(), output.end(), [&]( const auto& r ) {
+         return r.first == a && r.second == get_rex_order(a)["proceeds"].as<asset>();
+      }) );
+   }
+
+   // walking back from the final pool, every order was priced at the totals left by the one before it
+   const auto rex_pool = get_rex_pool();
+   int64_t S = rex_pool["total_lendable"].as<asset>().get_amount();
+   int64_t R = rex_pool["total_rex"].as<asset>().get_amount();
+   BOOST_REQUIRE_EQUAL( 0,                 rex_pool["total_lent"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( S,                 rex_pool["total_unlent"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( get_rex_balance(emily).get_amount(), R );
+   for ( auto r = output.rbegin(); r != output.rend(); ++r ) {
+      const int64_t rex = get_rex_order(r->first)["rex_requested"].as<asset>().get_amount();
+      const int64_t p   = r->second.get_amount();
+      S += p;
+      R += rex;
+      BOOST_REQUIRE_EQUAL( p, int64_t( ( eosio::chain::uint128_t(rex) * S ) / R ) );
+      BOOST_REQUIRE_EQUAL( 0, get_rex_balance(r->first).get_amount() );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( rex_loans, eosio_system_tester ) try {
 
    const int64_t ratio        = 10000;
@@ -4062,6 +4386,108 @@ BOOST_FIXTURE_TEST_CASE( rex_loans, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_loan_expiry_schedule, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("40000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount) };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("25000.0000") ) );
+   const asset payment = core_sym::from_string("30.0000");
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, payment, payment ) );
+
+   auto loan   = get_cpu_loan( 1 );
+   auto expiry = get_next_loan_expiry( true );
+   BOOST_REQUIRE_EQUAL( 1, loan["version"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( 1, expiry["loan_num"].as_uint64() );
+   const uint32_t expiration = fc::time_point_sec( loan["expiration"].as<fc::time_point>() ).sec_since_epoch();
+   BOOST_REQUIRE_EQUAL( expiration, expiry["slot"].as_uint64() >> 32 );
+   BOOST_REQUIRE( get_next_loan_expiry( false ).is_null() );
+
+   // renewal moves the loan 30 days ahead in the schedule
+   produce_block( fc::days(30) );
+   produce_blocks( 2 );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 2 ) );
+   loan   = get_cpu_loan( 1 );
+   expiry = get_next_loan_expiry( true );
+   BOOST_REQUIRE_EQUAL( 0, loan["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( 1, expiry["loan_num"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( expiration + 30 * 24 * 3600, expiry["slot"].as_uint64() >> 32 );
+
+   // and expiry without funds closes it
+   produce_block( fc::days(30) );
+   produce_blocks( 2 );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 2 ) );
+   BOOST_REQUIRE( get_cpu_loan( 1 ).is_null() );
+   BOOST_REQUIRE( get_next_loan_expiry( true ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( rex_result_row, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("1000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount) };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+
+   const asset amount = core_sym::from_string("100.0000");
+   const asset rex_received = get_buyrex_result( alice, amount );
+   BOOST_REQUIRE_EQUAL( asset::from_string("1000000.0000 REX"), rex_received );
+
+   std::function<size_t(const action_trace&)> count_actions = [&]( const action_trace& at ) {
+      size_t c = 1;
+      for ( const auto& it : at.inline_traces ) {
+         c += count_actions( it );
+      }
+      return c;
+   };
+   auto buyrex_actions = [&]() {
+      produce_blocks(1);
+      auto trace = base_tester::push_action( config::system_account_name, N(buyrex), alice, mvo()("from", alice)("amount", amount) );
+      size_t c = 0;
+      for ( const auto& at : trace->action_traces ) {
+         c += count_actions( at );
+      }
+      return c;
+   };
+   const size_t actions_with_result = buyrex_actions();
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of aliceaccount"),
+                        push_action( bob, N(setrexresult), mvo()("owner", alice)("use_row", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), setrexresult( alice, true ) );
+   BOOST_REQUIRE_EQUAL( 0, get_rex_result( alice )["sequence"].as_uint64() );
+
+   // result is written to the row, no buyresult action is sent
+   BOOST_REQUIRE_EQUAL( actions_with_result - 1, buyrex_actions() );
+   auto result = get_rex_result( alice );
+   BOOST_REQUIRE_EQUAL( "buyrex", result["action"].as_string() );
+   BOOST_REQUIRE_EQUAL( rex_received, result["result"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 1, result["sequence"].as_uint64() );
+
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( alice, bob, core_sym::from_string("1.0000") ) );
+   result = get_rex_result( alice );
+   BOOST_REQUIRE_EQUAL( "rentcpu", result["action"].as_string() );
+   BOOST_REQUIRE_EQUAL( 2, result["sequence"].as_uint64() );
+   BOOST_REQUIRE( get_rex_result( bob ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), setrexresult( alice, false ) );
+   BOOST_REQUIRE( get_rex_result( alice ).is_null() );
+   BOOST_REQUIRE_EQUAL( actions_with_result, buyrex_actions() );
+   produce_blocks(1);
+   BOOST_REQUIRE( get_buyrex_result( alice, amount ).get_amount() > 0 );
+
+   // a partial close keeps the result row, a full close removes it
+   BOOST_REQUIRE_EQUAL( success(), setrexresult( bob, true ) );
+   BOOST_REQUIRE_EQUAL( success(), closerex( bob ) );
+   BOOST_REQUIRE_EQUAL( init_balance, get_rex_fund( bob ) );
+   BOOST_REQUIRE( !get_rex_result( bob ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), withdraw( bob, init_balance ) );
+   BOOST_REQUIRE_EQUAL( success(), closerex( bob ) );
+   BOOST_REQUIRE( get_rex_result( bob ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( rex_loan_checks, eosio_system_tester ) try {
 
    const int64_t ratio        = 10000;
@@ -4167,6 +4593,7 @@ BOOST_FIXTURE_TEST_CASE( rex_maturity, eosio_system_tester ) try {
       BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("25.0000") ) );
 
       auto rex_balance = get_rex_balance_obj( alice );
+      BOOST_REQUIRE_EQUAL( 1,                  rex_balance["version"].as<uint8_t>() );
       BOOST_REQUIRE_EQUAL( 550000 * rex_ratio, rex_balance["rex_balance"].as<asset>().get_amount() );
       BOOST_REQUIRE_EQUAL( 0,                  rex_balance["matured_rex"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( 2,                  rex_balance["rex_maturities"].get_array().size() );
@@ -4293,6 +4720,85 @@ BOOST_FIXTURE_TEST_CASE( rex_maturity, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( rex_balance_v0_conversion, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("1000000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount) };
+   account_name alice = accounts[0];
+   setup_rex_accounts( accounts, init_balance );
+
+   const int64_t  rex_ratio       = 10000;
+   const uint32_t seconds_per_day = 24 * 3600;
+
+   // version 0 rows predate rex_maturity_slots, rewrite a version 1 row the way they were stored
+   auto set_rex_balance_row = [&]( const account_name& owner, const fc::variant& row ) {
+      namespace chain = eosio::chain;
+      auto& db = const_cast<chainbase::database&>( control->db() );
+      const auto* t_id = db.find<chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( config::system_account_name, config::system_account_name, N(rexbal) ) );
+      BOOST_REQUIRE( t_id );
+      const auto* obj = db.find<chain::key_value_object, chain::by_scope_primary>( boost::make_tuple( t_id->id, owner.value ) );
+      BOOST_REQUIRE( obj );
+      const auto data = abi_ser.variant_to_binary( "rex_balance", row, abi_serializer_max_time );
+      db.modify( *obj, [&]( auto& o ) { o.value.assign( data.data(), data.size() ); } );
+   };
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("30.0000") ) );
+
+   // one bucket matured at the start of today, two still pending and the savings bucket
+   const uint32_t today = control->pending_block_time().sec_since_epoch() / seconds_per_day;
+   auto rex_balance = get_rex_balance_obj( alice );
+   BOOST_REQUIRE_EQUAL( 300000 * rex_ratio, rex_balance["rex_balance"].as<asset>().get_amount() );
+   set_rex_balance_row( alice, mvo()
+                        ("version", 0)
+                        ("owner", alice)
+                        ("vote_stake", rex_balance["vote_stake"])
+                        ("rex_balance", rex_balance["rex_balance"])
+                        ("matured_rex", 0)
+                        ("rex_maturities", fc::variants{
+                           mvo()("first", fc::time_point_sec( today * seconds_per_day ))("second", 50000 * rex_ratio),
+                           mvo()("first", fc::time_point_sec( (today + 1) * seconds_per_day ))("second", 150000 * rex_ratio),
+                           mvo()("first", fc::time_point_sec( (today + 5) * seconds_per_day ))("second", 20000 * rex_ratio),
+                           mvo()("first", fc::time_point_sec::maximum())("second", 80000 * rex_ratio) }) );
+   rex_balance = get_rex_balance_obj( alice );
+   BOOST_REQUIRE_EQUAL( 0, rex_balance["version"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( 4, rex_balance["rex_maturities"].get_array().size() );
+
+   // only the matured bucket can be sold, the others keep their days
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
+                        sellrex( alice, asset::from_string("50000.0001 REX") ) );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( alice, asset::from_string("50000.0000 REX") ) );
+   rex_balance = get_rex_balance_obj( alice );
+   BOOST_REQUIRE_EQUAL( 1,                  rex_balance["version"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( 250000 * rex_ratio, rex_balance["rex_balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( 0,                  rex_balance["matured_rex"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( today,              rex_balance["maturity_slots"]["last_day"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( 80000 * rex_ratio,  rex_balance["maturity_slots"]["savings"].as<int64_t>() );
+   const auto& maturities = rex_balance["rex_maturities"].get_array();
+   BOOST_REQUIRE_EQUAL( 3,                                           maturities.size() );
+   BOOST_REQUIRE_EQUAL( (today + 1) * seconds_per_day,               maturities[0]["first"].as<fc::time_point_sec>().sec_since_epoch() );
+   BOOST_REQUIRE_EQUAL( 150000 * rex_ratio,                          maturities[0]["second"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( (today + 5) * seconds_per_day,               maturities[1]["first"].as<fc::time_point_sec>().sec_since_epoch() );
+   BOOST_REQUIRE_EQUAL( 20000 * rex_ratio,                           maturities[1]["second"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( fc::time_point_sec::maximum().sec_since_epoch(), maturities[2]["first"].as<fc::time_point_sec>().sec_since_epoch() );
+   BOOST_REQUIRE_EQUAL( 80000 * rex_ratio,                           maturities[2]["second"].as<int64_t>() );
+
+   // pending buckets mature on their day, savings never do
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
+                        sellrex( alice, asset::from_string("150000.0001 REX") ) );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( alice, asset::from_string("150000.0000 REX") ) );
+   produce_block( fc::days(4) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
+                        sellrex( alice, asset::from_string("20000.0001 REX") ) );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( alice, asset::from_string("20000.0000 REX") ) );
+   rex_balance = get_rex_balance_obj( alice );
+   BOOST_REQUIRE_EQUAL( 80000 * rex_ratio, rex_balance["rex_balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( 0,                 rex_balance["matured_rex"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( 1,                 rex_balance["rex_maturities"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 80000 * rex_ratio, rex_balance["maturity_slots"]["savings"].as<int64_t>() );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
 
@@ -4839,6 +5345,42 @@ BOOST_FIXTURE_TEST_CASE( set_rex, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_maintenance_budget, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("25000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount), N(carolaccount) };
+   account_name alice = accounts[0], bob = accounts[1], carol = accounts[2];
+   setup_rex_accounts( accounts, init_balance );
+
+   const name act_name{ N(setrexmaint) };
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( alice, act_name, mvo()("max_per_action", 0)("max_per_block", 2) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rex system is not initialized"),
+                        push_action( config::system_account_name, act_name, mvo()("max_per_action", 0)("max_per_block", 0) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("20000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( config::system_account_name, act_name, mvo()("max_per_action", 0)("max_per_block", 0) ) );
+
+   const int64_t init_cpu_limit = get_cpu_limit( carol );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, carol, core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE( init_cpu_limit < get_cpu_limit( carol ) );
+
+   // loan has expired but neither user actions nor blocks are allowed to close it
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE( init_cpu_limit < get_cpu_limit( carol ) );
+
+   // onblock closes it once given a budget
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( config::system_account_name, act_name, mvo()("max_per_action", 0)("max_per_block", 2) ) );
+   produce_blocks( 2 );
+   BOOST_REQUIRE_EQUAL( init_cpu_limit, get_cpu_limit( carol ) );
+   BOOST_REQUIRE_EQUAL( 0, get_rex_pool()["total_lent"].as<asset>().get_amount() );
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( b1_vesting, eosio_system_tester ) try {
 
    cross_15_percent_threshold();
@@ -1,6 +1,7 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/resource_limits.hpp>
 #include "eosio.system_tester.hpp"
 
 #include "Runtime/Runtime.h"
@@ -63,6 +64,76 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "account", data, abi_serializer_max_time );
    }
 
+   fc::variant get_bonus_accumulator()
+   {
+      vector<char> data = get_row_by_account( N(eosio.token), 0, N(bacc), N(bacc) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "bonus_accumulator", data, abi_serializer_max_time );
+   }
+
+   // transfer fees not swept into eosio.saving yet, summed over every fee shard
+   int64_t get_unswept_fees()
+   {
+      const auto& db = control->db();
+      const auto* t_id = db.find<table_id_object, by_code_scope_table>( boost::make_tuple( N(eosio.token), uint64_t(0), N(feeshard) ) );
+      if ( !t_id ) {
+         return 0;
+      }
+
+      int64_t total = 0;
+      const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+      for ( auto itr = idx.lower_bound( boost::make_tuple( t_id->id, 0 ) ); itr != idx.end() && itr->t_id == t_id->id; ++itr ) {
+         vector<char> data( itr->value.size() );
+         memcpy( data.data(), itr->value.data(), data.size() );
+         total += abi_ser.binary_to_variant( "fee_shard", data, abi_serializer_max_time )["fee"].as<asset>().get_amount();
+      }
+      return total;
+   }
+
+   // abms shard scope holding owner's record, -1 if there is none
+   int64_t get_abms_shard( account_name owner )
+   {
+      for ( uint64_t shard = 0; shard < 8; ++shard ) {
+         if ( !get_row_by_account( N(eosio.token), shard, N(abms), owner ).empty() ) {
+            return shard;
+         }
+      }
+      return -1;
+   }
+
+   // abms record of owner, looked up in every abms shard scope
+   fc::variant get_abms( account_name owner )
+   {
+      const int64_t shard = get_abms_shard( owner );
+      if ( shard < 0 ) {
+         return fc::variant();
+      }
+      vector<char> data = get_row_by_account( N(eosio.token), shard, N(abms), owner );
+      return abi_ser.binary_to_variant( "account_bonus_meta", data, abi_serializer_max_time );
+   }
+
+   // clearing progress kept in the scope of one abms shard
+   fc::variant get_bonus_shard( uint64_t shard )
+   {
+      vector<char> data = get_row_by_account( N(eosio.token), shard, N(brshard), N(brshard) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "bonus_shard", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_bonus_round()
+   {
+      vector<char> data = get_row_by_account( N(eosio.token), 0, N(brnd), 1 );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "bonus_round", data, abi_serializer_max_time );
+   }
+
+   // bonus clearing sends inline actions with the issuer's active permission
+   void allow_inline( account_name issuer ) {
+      set_authority( issuer, config::active_name,
+                     authority( 1, {{get_public_key( issuer, "active" ), 1}},
+                                   {{{N(eosio.token), config::eosio_code_name}, 1}} ),
+                     config::owner_name,
+                     { { issuer, config::owner_name } },
+                     { get_private_key( issuer, "owner" ) } );
+   }
+
    action_result create( account_name issuer,
                 asset        maximum_supply ) {
 
@@ -100,6 +171,14 @@ public:
       );
    }
 
+   action_result transfermany( account_name from,
+                               const fc::variants& transfers ) {
+      return push_action( from, N(transfermany), mvo()
+           ( "from", from)
+           ( "transfers", transfers)
+      );
+   }
+
    action_result open( account_name owner,
                        const string& symbolname,
                        account_name ram_payer    ) {
@@ -243,6 +322,51 @@ BOOST_FIXTURE_TEST_CASE( issue_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( issuemany_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000.000000 HOT") ) );
+
+   auto issues = fc::variants{
+      mvo()("to", "bob")("quantity", "10.000000 HOT"),
+      mvo()("to", "carol")("quantity", "20.000000 HOT"),
+      mvo()("to", "bob")("quantity", "5.000000 HOT"),
+      mvo()("to", "alice")("quantity", "1.000000 HOT")
+   };
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(issuemany), mvo()("issues", issues)("memo", "genesis") ) );
+
+   REQUIRE_MATCHING_OBJECT( get_stats("6,HOT"), mvo()
+      ("supply", "36.000000 HOT")
+      ("max_supply", "1000.000000 HOT")
+      ("issuer", "alice")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "15.000000 HOT")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "6,HOT"), mvo()
+      ("balance", "20.000000 HOT")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "1.000000 HOT")
+   );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+      push_action( N(bob), N(issuemany), mvo()("issues", issues)("memo", "genesis") )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "quantity exceeds available supply" ),
+      push_action( N(alice), N(issuemany), mvo()
+         ("issues", fc::variants{ mvo()("to", "bob")("quantity", "900.000000 HOT"),
+                                  mvo()("to", "carol")("quantity", "100.000000 HOT") })
+         ("memo", "") )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "to account does not exist" ),
+      push_action( N(alice), N(issuemany), mvo()
+         ("issues", fc::variants{ mvo()("to", "nobody")("quantity", "1.000000 HOT") })
+         ("memo", "") )
+   );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( retire_tests, eosio_token_tester ) try {
 
    auto token = create( N(alice), asset::from_string("1000.000 TKN"));
@@ -415,4 +539,644 @@ BOOST_FIXTURE_TEST_CASE( close_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( transfermany_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("1000000.000000 HOT"), "hola" ) );
+
+   const size_t n = 10;
+   vector<account_name> rcpts;
+   for ( size_t i = 0; i < n; ++i ) {
+      rcpts.emplace_back( string("rcpt.") + char('a' + i) );
+   }
+   create_accounts( rcpts );
+   produce_blocks(1);
+
+   std::function<size_t(const action_trace&)> count_actions = [&]( const action_trace& at ) {
+      size_t c = 1;
+      for ( const auto& it : at.inline_traces ) {
+         c += count_actions( it );
+      }
+      return c;
+   };
+   auto trace_actions = [&]( const transaction_trace_ptr& trace ) {
+      size_t c = 0;
+      for ( const auto& at : trace->action_traces ) {
+         c += count_actions( at );
+      }
+      return c;
+   };
+
+   // n separate transfers
+   uint64_t single_cpu = 0;
+   size_t single_actions = 0;
+   for ( const auto& r : rcpts ) {
+      auto trace = base_tester::push_action( N(eosio.token), N(transfer), N(alice), mvo()
+           ( "from", "alice")
+           ( "to", r)
+           ( "quantity", "1.000000 HOT")
+           ( "memo", "single")
+      );
+      single_cpu += trace->receipt->cpu_usage_us;
+      single_actions += trace_actions( trace );
+   }
+   produce_blocks(1);
+
+   // the same payout as one batch
+   fc::variants transfers;
+   for ( const auto& r : rcpts ) {
+      transfers.push_back( mvo()
+           ( "to", r)
+           ( "quantity", "1.000000 HOT")
+           ( "memo", "batch")
+      );
+   }
+   auto trace = base_tester::push_action( N(eosio.token), N(transfermany), N(alice), mvo()
+        ( "from", "alice")
+        ( "transfers", transfers)
+   );
+   uint64_t batch_cpu = trace->receipt->cpu_usage_us;
+   size_t batch_actions = trace_actions( trace );
+   produce_blocks(1);
+
+   BOOST_TEST_MESSAGE( "transfer x" << n << ": " << single_cpu << " us, " << single_actions << " actions, "
+                       << single_cpu / n << " us per recipient" );
+   BOOST_TEST_MESSAGE( "transfermany(" << n << "): " << batch_cpu << " us, " << batch_actions << " actions, "
+                       << batch_cpu / n << " us per recipient" );
+   BOOST_REQUIRE( batch_actions < single_actions );
+
+   for ( const auto& r : rcpts ) {
+      REQUIRE_MATCHING_OBJECT( get_account(r, "6,HOT"), mvo()
+         ("balance", "2.000000 HOT")
+      );
+   }
+   // 1000u minimum fee for each of the 2n payouts, held in fee shards until swept
+   BOOST_REQUIRE_EQUAL( true, get_account(N(eosio.saving), "6,HOT").is_null() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(sweepfees), mvo() ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.saving), "6,HOT"), mvo()
+      ("balance", "0.020000 HOT")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "999979.980000 HOT")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+      transfermany( N(alice), fc::variants{ mvo()("to", "alice")("quantity", "1.000000 HOT")("memo", "") } )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+      transfermany( N(alice), fc::variants{ mvo()("to", "bob")("quantity", "999979.980000 HOT")("memo", "") } )
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( sweepfees_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("100.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(bob), asset::from_string("100.000000 HOT"), "hola" ) );
+
+   // 1000u minimum fee of each transfer waits in the sender's fee shard
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(carol), asset::from_string("1.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(carol), asset::from_string("1.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( 2000, get_unswept_fees() );
+   BOOST_REQUIRE_EQUAL( true, get_account(N(eosio.saving), "6,HOT").is_null() );
+
+   // anyone may sweep, eosio.saving's bonus base grows with its balance
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(carol), N(sweepfees), mvo() ) );
+   BOOST_REQUIRE_EQUAL( 0, get_unswept_fees() );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.saving), "6,HOT"), mvo()
+      ("balance", "0.002000 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( 2000, get_abms( N(eosio.saving) )["balance"].as_int64() );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(carol), N(sweepfees), mvo() ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.saving), "6,HOT"), mvo()
+      ("balance", "0.002000 HOT")
+   );
+
+   // a shard sweeps itself on its 32nd fee
+   for ( int i = 0; i < 31; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(carol), asset::from_string("0.100000 HOT"), std::to_string(i) ) );
+   }
+   BOOST_REQUIRE_EQUAL( 31000, get_unswept_fees() );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(carol), asset::from_string("0.100000 HOT"), "31" ) );
+   BOOST_REQUIRE_EQUAL( 0, get_unswept_fees() );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.saving), "6,HOT"), mvo()
+      ("balance", "0.034000 HOT")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( bonus_accrue_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   for ( auto holder : { N(alice), N(bob), N(carol) } ) {
+      BOOST_REQUIRE_EQUAL( success(), issue( N(alice), holder, asset::from_string("1.000000 HOT"), "hola" ) );
+   }
+
+   auto accrue = [&]( account_name issuer, const string& bonus ) {
+      return push_action( issuer, N(bonusaccrue), mvo()("bonus", bonus) );
+   };
+   auto claim = [&]( account_name owner ) {
+      return push_action( owner, N(claimbonus), mvo()("owner", owner) );
+   };
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), accrue( N(bob), "0.000010 HOT" ) );
+   BOOST_REQUIRE_EQUAL( success(), accrue( N(alice), "0.000010 HOT" ) );
+   // the whole bonus is issued into reserve, 10u over 3 HOT is 3u each and 1u left over
+   REQUIRE_MATCHING_OBJECT( get_stats("6,HOT"), mvo()
+      ("supply", "3.000010 HOT")
+      ("max_supply", "1000000.000000 HOT")
+      ("issuer", "alice")
+   );
+   BOOST_REQUIRE_EQUAL( 10, get_bonus_accumulator()["reserve"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 1, get_bonus_accumulator()["accruals"].as_uint64() );
+
+   BOOST_REQUIRE_EQUAL( success(), claim( N(bob) ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "1.000003 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no bonus to claim" ), claim( N(bob) ) );
+   BOOST_REQUIRE_EQUAL( 7, get_bonus_accumulator()["reserve"].as_int64() );
+
+   // the bonus accrued on the balance held before the transfer is kept for carol and alice
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(carol), N(alice), asset::from_string("0.500000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), claim( N(carol) ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "6,HOT"), mvo()
+      ("balance", "0.499003 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( success(), claim( N(alice) ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "1.500003 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no bonus to claim" ), claim( N(alice) ) );
+
+   // rounding remainder stays in reserve
+   BOOST_REQUIRE_EQUAL( 1, get_bonus_accumulator()["reserve"].as_int64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( bonusbulk_tests, eosio_token_tester ) try {
+
+   const vector<account_name> holders = { N(bob), N(carol), N(holder.a), N(holder.b), N(holder.c), N(holder.d) };
+   const vector<string> balances = { "1.000000 HOT", "2.000000 HOT", "3.000000 HOT", "4.000000 HOT", "5.000000 HOT", "0.010000 HOT" };
+   // the same round, cleared in bulk here and by one inline bonus per account on a second chain
+   auto freeze = [&]( eosio_token_tester& t ) {
+      t.create_accounts( { N(eosio.saving), N(holder.a), N(holder.b), N(holder.c), N(holder.d) } );
+      t.allow_inline( N(alice) );
+      BOOST_REQUIRE_EQUAL( t.success(), t.create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+      for ( size_t i = 0; i < holders.size(); ++i ) {
+         BOOST_REQUIRE_EQUAL( t.success(), t.issue( N(alice), holders[i], asset::from_string(balances[i]), "hola" ) );
+      }
+      BOOST_REQUIRE_EQUAL( t.success(), t.push_action( N(alice), N(bonusfreeze), mvo()
+         ("bonus", "1.000000 HOT")("minimum", "0.001000 HOT")("collector", "alice") ) );
+   };
+
+   eosio_token_tester per_account;
+   freeze( per_account );
+   for ( uint8_t shard = 0; shard < 8; ++shard ) {
+      while ( per_account.get_bonus_round()["clearing"].as_bool() &&
+              per_account.success() == per_account.push_action( N(alice), N(bonusclear), mvo()("shard", shard) ) ) {
+         per_account.produce_blocks(1);
+      }
+   }
+   BOOST_REQUIRE_EQUAL( false, per_account.get_bonus_round()["clearing"].as_bool() );
+
+   freeze( *this );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), push_action( N(bob), N(bonusbulk), mvo()("max_accounts", 2) ) );
+   // 2 accounts per call, every call resumes where the previous one stopped
+   size_t calls = 0;
+   while ( get_bonus_round()["clearing"].as_bool() ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(bonusbulk), mvo()("max_accounts", 2) ) );
+      produce_blocks(1);
+      BOOST_REQUIRE( ++calls <= holders.size() );
+   }
+   BOOST_REQUIRE( calls >= 3 );
+
+   // 1 HOT over 15.01 HOT, holder.d's 666u is below the minimum and goes to the collector
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "1.066622 HOT")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(holder.d), "6,HOT"), mvo()
+      ("balance", "0.010000 HOT")
+   );
+   for ( auto acc : holders ) {
+      BOOST_REQUIRE_EQUAL( per_account.get_account(acc, "6,HOT")["balance"].as_string(), get_account(acc, "6,HOT")["balance"].as_string() );
+   }
+   BOOST_REQUIRE_EQUAL( per_account.get_account(N(alice), "6,HOT")["balance"].as_string(), get_account(N(alice), "6,HOT")["balance"].as_string() );
+   BOOST_REQUIRE_EQUAL( per_account.get_stats("6,HOT")["supply"].as_string(), get_stats("6,HOT")["supply"].as_string() );
+   REQUIRE_MATCHING_OBJECT( get_stats("6,HOT"), mvo()
+      ("supply", "16.010000 HOT")
+      ("max_supply", "1000000.000000 HOT")
+      ("issuer", "alice")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( bonusclear_shard_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving), N(holder.a), N(holder.b), N(holder.c), N(holder.d) } );
+   allow_inline( N(alice) );
+   const vector<account_name> holders = { N(bob), N(carol), N(holder.a), N(holder.b), N(holder.c), N(holder.d) };
+   const vector<string> balances = { "1.000000 HOT", "2.000000 HOT", "3.000000 HOT", "4.000000 HOT", "5.000000 HOT", "0.010000 HOT" };
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   for ( size_t i = 0; i < holders.size(); ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), issue( N(alice), holders[i], asset::from_string(balances[i]), "hola" ) );
+   }
+   auto freeze = [&]() {
+      return push_action( N(alice), N(bonusfreeze), mvo()
+         ("bonus", "1.000000 HOT")("minimum", "0.001000 HOT")("collector", "alice") );
+   };
+   auto clear = [&]( uint64_t shard ) {
+      return push_action( N(alice), N(bonusclear), mvo()("shard", shard) );
+   };
+   // the bonus is issued at freeze, so it has to fit under max supply
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "bonus exceeds available supply" ), push_action( N(alice), N(bonusfreeze), mvo()
+      ("bonus", "999990.000000 HOT")("minimum", "0.001000 HOT")("collector", "alice") ) );
+   BOOST_REQUIRE_EQUAL( success(), freeze() );
+   BOOST_REQUIRE_EQUAL( "16.010000 HOT", get_stats("6,HOT")["supply"].as_string() );
+
+   // clearing bob's shard only credits that shard, supply and round stay untouched
+   const int64_t bob_shard = get_abms_shard( N(bob) );
+   BOOST_REQUIRE( bob_shard >= 0 );
+   BOOST_REQUIRE_EQUAL( success(), clear( bob_shard ) );
+   produce_blocks(1);
+   while ( !get_bonus_shard( bob_shard )["cleared"].as_bool() ) {
+      BOOST_REQUIRE_EQUAL( success(), clear( bob_shard ) );
+      produce_blocks(1);
+   }
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "abms shard is already cleared" ), clear( bob_shard ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "1.066622 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( 1, get_bonus_shard( bob_shard )["round"].as_uint64() );
+   BOOST_REQUIRE( get_bonus_shard( bob_shard )["paid"].as<asset>().get_amount() >= 66622 );
+   BOOST_REQUIRE_EQUAL( "16.010000 HOT", get_stats("6,HOT")["supply"].as_string() );
+   BOOST_REQUIRE_EQUAL( "1.000000 HOT", get_bonus_round()["balance"].as_string() );
+   BOOST_REQUIRE_EQUAL( true, get_account( N(alice), "6,HOT" ).is_null() );
+
+   // the last cleared shard closes the round, which hands what the shards did not pay to the collector
+   for ( uint64_t shard = 0; shard < 8 && get_bonus_round()["clearing"].as_bool(); ++shard ) {
+      while ( get_bonus_round()["clearing"].as_bool() && success() == clear( shard ) ) {
+         produce_blocks(1);
+      }
+   }
+   BOOST_REQUIRE_EQUAL( false, get_bonus_round()["clearing"].as_bool() );
+   int64_t paid = 0;
+   for ( uint64_t shard = 0; shard < 8; ++shard ) {
+      auto progress = get_bonus_shard( shard );
+      if ( !progress.is_null() ) {
+         BOOST_REQUIRE_EQUAL( true, progress["cleared"].as_bool() );
+         paid += progress["paid"].as<asset>().get_amount();
+      }
+   }
+   BOOST_REQUIRE_EQUAL( 1000000, paid + get_account( N(alice), "6,HOT" )["balance"].as<asset>().get_amount() );
+   REQUIRE_MATCHING_OBJECT( get_stats("6,HOT"), mvo()
+      ("supply", "16.010000 HOT")
+      ("max_supply", "1000000.000000 HOT")
+      ("issuer", "alice")
+   );
+
+   // progress of the previous round does not count in the next one
+   BOOST_REQUIRE_EQUAL( success(), freeze() );
+   BOOST_REQUIRE_EQUAL( success(), clear( bob_shard ) );
+   BOOST_REQUIRE_EQUAL( 2, get_bonus_shard( bob_shard )["round"].as_uint64() );
+   BOOST_REQUIRE( get_account(N(bob), "6,HOT")["balance"].as<asset>().get_amount() > 1066622 );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( migrateabms_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("20.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(bob), asset::from_string("10.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(carol), asset::from_string("5.000000 HOT"), "hola" ) );
+
+   // 0.01 HOT per HOT held, settled into the abms records
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(bonusaccrue), mvo()("bonus", "0.350000 HOT") ) );
+
+   const vector<account_name> holders = { N(alice), N(bob), N(carol) };
+   auto v1_rows = [&]() {
+      return std::count_if( holders.begin(), holders.end(), [&]( account_name n ) { return !get_abms( n ).is_null(); } );
+   };
+   BOOST_REQUIRE_EQUAL( 3, v1_rows() );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio.token" ), push_action( N(alice), N(migrateabms), mvo()("max_rows", 1) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio.token), N(migrateabms), mvo()("max_rows", 1) ) );
+   BOOST_REQUIRE_EQUAL( 2, v1_rows() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio.token), N(migrateabms), mvo()("max_rows", 10) ) );
+   BOOST_REQUIRE_EQUAL( 0, v1_rows() );
+
+   // bonus meta moved into the balance row with what was accrued so far
+   auto bob_row = get_account( N(bob), "6,HOT" );
+   BOOST_REQUIRE_EQUAL( "10.000000 HOT", bob_row["balance"].as_string() );
+   BOOST_REQUIRE_EQUAL( 0, bob_row["meta"]["stake"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 100000, bob_row["meta"]["pending"].as_int64() );
+
+   // retire settles the issuer's bonus and lowers its base
+   BOOST_REQUIRE_EQUAL( success(), retire( N(alice), asset::from_string("1.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( 200000, get_account( N(alice), "6,HOT" )["meta"]["pending"].as_int64() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(bonusaccrue), mvo()("bonus", "0.340000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(claimbonus), mvo()("owner", "alice") ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "19.390000 HOT")
+   );
+
+   // close needs a zero balance and no unclaimed bonus
+   auto close_hot = [&]( account_name owner ) {
+      return push_action( owner, N(close), mvo()("owner", owner)("symbol", "6,HOT") );
+   };
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(carol), N(bob), asset::from_string("4.995005 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( "0.000000 HOT", get_account( N(carol), "6,HOT" )["balance"].as_string() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "Cannot close because the bonus is not claimed." ), close_hot( N(carol) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(carol), N(claimbonus), mvo()("owner", "carol") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "Cannot close because the balance is not zero." ), close_hot( N(carol) ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(carol), N(bob), asset::from_string("0.099000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), close_hot( N(carol) ) );
+   BOOST_REQUIRE_EQUAL( true, get_account( N(carol), "6,HOT" ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( migrateabms_ram_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("20.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(bob), asset::from_string("10.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(bonusaccrue), mvo()("bonus", "0.300000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio.token), N(migrateabms), mvo()("max_rows", 1) ) );
+
+   // rows converted by their signing owners are billed to them, not to the contract
+   auto token_ram = [&]() {
+      return control->get_resource_limits_manager().get_account_ram_usage( N(eosio.token) );
+   };
+   const int64_t ram = token_ram();
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(claimbonus), mvo()("owner", "alice") ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(bob), N(claimbonus), mvo()("owner", "bob") ) );
+   BOOST_REQUIRE( get_account( N(alice), "6,HOT" ).get_object().contains( "meta" ) );
+   BOOST_REQUIRE( get_account( N(bob), "6,HOT" ).get_object().contains( "meta" ) );
+   BOOST_REQUIRE( token_ram() <= ram );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( shardabms_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   allow_inline( N(alice) );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(bob), asset::from_string("10.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(carol), asset::from_string("5.000000 HOT"), "hola" ) );
+
+   auto shard_abms = [&]( uint32_t max_rows ) {
+      return push_action( N(eosio.token), N(shardabms), mvo()("max_rows", max_rows) );
+   };
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio.token" ), push_action( N(alice), N(shardabms), mvo()("max_rows", 1) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "max_rows should be greater than 0" ), shard_abms( 0 ) );
+
+   // a record moved during clearing could skip its round
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(bonusfreeze), mvo()
+      ("bonus", "1.000000 HOT")("minimum", "0.001000 HOT")("collector", "alice") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot shard abms records in process of bonus clearing" ), shard_abms( 10 ) );
+   for ( uint64_t shard = 0; shard < 8 && get_bonus_round()["clearing"].as_bool(); ++shard ) {
+      while ( get_bonus_round()["clearing"].as_bool() && success() == push_action( N(alice), N(bonusclear), mvo()("shard", shard) ) ) {
+         produce_blocks(1);
+      }
+   }
+   BOOST_REQUIRE_EQUAL( false, get_bonus_round()["clearing"].as_bool() );
+
+   // once scope 0 is scanned, lookups no longer fall back to it
+   BOOST_REQUIRE( get_bonus_accumulator().is_null() || !get_bonus_accumulator().get_object().contains( "abms_sharded" ) );
+   BOOST_REQUIRE_EQUAL( success(), shard_abms( 10 ) );
+   BOOST_REQUIRE_EQUAL( true, get_bonus_accumulator()["abms_sharded"].as_bool() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "abms records are already sharded" ), shard_abms( 10 ) );
+
+   // records keep working from their shards
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(carol), asset::from_string("1.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE( get_abms( N(bob) )["balance"].as_int64() < 10000000 );
+   BOOST_REQUIRE( get_abms( N(carol) )["balance"].as_int64() > 6000000 );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( abms_gc_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   allow_inline( N(alice) );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("1000.000000 HOT"), "hola" ) );
+
+   auto bob_abms = [&]() {
+      return get_abms( N(bob) );
+   };
+
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("10.010000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( false, bob_abms().is_null() );
+
+   // paying out everything, fee included, leaves nothing to keep the record for
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(alice), asset::from_string("10.000000 HOT"), "hola" ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "0.000000 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( true, bob_abms().is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("1.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( false, bob_abms().is_null() );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio.token" ), push_action( N(alice), N(gcabms), mvo()("max_rows", 10) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio.token), N(gcabms), mvo()("max_rows", 10) ) );
+   BOOST_REQUIRE_EQUAL( false, bob_abms().is_null() );
+
+   // emptied during a round, the record stays to be cleared, and a bonus below the minimum leaves it dormant
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(bonusfreeze), mvo()
+      ("bonus", "1.000000 HOT")("minimum", "0.500000 HOT")("collector", "alice") ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(alice), asset::from_string("0.999000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( false, bob_abms().is_null() );
+   for ( uint64_t shard = 0; shard < 8; ++shard ) {
+      while ( get_bonus_round()["clearing"].as_bool() &&
+              success() == push_action( N(alice), N(bonusclear), mvo()("shard", shard) ) ) {
+         produce_blocks(1);
+      }
+   }
+   BOOST_REQUIRE_EQUAL( false, get_bonus_round()["clearing"].as_bool() );
+   auto dormant = bob_abms();
+   BOOST_REQUIRE_EQUAL( false, dormant.is_null() );
+   BOOST_REQUIRE_EQUAL( 0, dormant["balance"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 0, dormant["stake"].as_int64() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio.token), N(gcabms), mvo()("max_rows", 20) ) );
+   BOOST_REQUIRE_EQUAL( true, bob_abms().is_null() );
+   BOOST_REQUIRE_EQUAL( false, get_abms( N(alice) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( drop_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000.000000 HOT") ) );
+
+   // leaves and nodes as eosio.token hashes them
+   auto leaf = []( account_name owner, const string& amount ) {
+      const auto a = asset::from_string( amount );
+      const uint64_t fields[3] = { owner.value, uint64_t(a.get_amount()), a.get_symbol().value() };
+      return fc::sha256::hash( reinterpret_cast<const char*>(fields), sizeof(fields) );
+   };
+   auto node = []( const fc::sha256& a, const fc::sha256& b ) {
+      const bool a_first = memcmp( a.data(), b.data(), a.data_size() ) <= 0;
+      char buf[64];
+      memcpy( buf, ( a_first ? a : b ).data(), 32 );
+      memcpy( buf + 32, ( a_first ? b : a ).data(), 32 );
+      return fc::sha256::hash( buf, sizeof(buf) );
+   };
+   const auto leaf_bob = leaf( N(bob), "10.000000 HOT" );
+   const auto leaf_carol = leaf( N(carol), "20.000000 HOT" );
+   const auto root = node( leaf_bob, leaf_carol );
+   const auto expiry = control->head_block_time() + fc::days(1);
+
+   auto claim = [&]( account_name owner, const string& amount, const fc::sha256& sibling ) {
+      return push_action( owner, N(claimdrop), mvo()
+         ("owner", owner)
+         ("amount", amount)
+         ("proof", fc::variants{ fc::variant(sibling) })
+      );
+   };
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), push_action( N(bob), N(setdrop), mvo()
+      ("total", "30.000000 HOT")("root", root)("expiry", expiry) )
+   );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(setdrop), mvo()
+      ("total", "30.000000 HOT")("root", root)("expiry", expiry) )
+   );
+   // nothing is issued up front
+   REQUIRE_MATCHING_OBJECT( get_stats("6,HOT"), mvo()
+      ("supply", "0.000000 HOT")
+      ("max_supply", "1000.000000 HOT")
+      ("issuer", "alice")
+   );
+
+   BOOST_REQUIRE_EQUAL( success(), claim( N(bob), "10.000000 HOT", leaf_carol ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "10.000000 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "already claimed" ), claim( N(bob), "10.000000 HOT", leaf_carol ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "invalid merkle proof" ), claim( N(carol), "25.000000 HOT", leaf_bob ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "drop has not expired yet" ),
+      push_action( N(alice), N(enddrop), mvo()("sym", "HOT") )
+   );
+
+   produce_block( fc::days(2) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "drop has expired" ), claim( N(carol), "20.000000 HOT", leaf_bob ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(enddrop), mvo()("sym", "HOT") ) );
+   REQUIRE_MATCHING_OBJECT( get_stats("6,HOT"), mvo()
+      ("supply", "10.000000 HOT")
+      ("max_supply", "1000.000000 HOT")
+      ("issuer", "alice")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( channel_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.saving) } );
+   BOOST_REQUIRE_EQUAL( success(), create( N(alice), asset::from_string("1000000.000000 HOT") ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("100.000000 HOT"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(bob), asset::from_string("20.000000 HOT"), "hola" ) );
+
+   auto chopen = [&]( account_name owner, account_name peer, const string& quantity ) {
+      return push_action( owner, N(chopen), mvo()
+         ("owner", owner)("peer", peer)("quantity", quantity)("key", get_public_key( owner, "active" )) );
+   };
+   auto channel_id = [&]() {
+      vector<char> data = get_row_by_account( N(eosio.token), N(alice), N(channels), N(bob) );
+      return abi_ser.binary_to_variant( "channel", data, abi_serializer_max_time )["id"].as_uint64();
+   };
+   const fc::sha256 chain_id = control->get_chain_id();
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "channel chain id is not set" ), chopen( N(alice), N(bob), "10.000000 HOT" ) );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio.token" ), push_action( N(alice), N(chinit), mvo()("chain_id", chain_id) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio.token), N(chinit), mvo()("chain_id", chain_id) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "channel chain id is already set" ), push_action( N(eosio.token), N(chinit), mvo()("chain_id", chain_id) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), chopen( N(alice), N(bob), "10.000000 HOT" ) );
+   BOOST_REQUIRE_EQUAL( success(), chopen( N(bob), N(alice), "10.000000 HOT" ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "already locked into this channel" ), chopen( N(bob), N(alice), "1.000000 HOT" ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "90.000000 HOT")
+   );
+
+   BOOST_REQUIRE_EQUAL( 1, channel_id() );
+
+   // both sign the state off chain, for this chain and channel instance
+   auto signed_state = [&]( uint64_t id, uint64_t nonce, const string& balance_a, const string& balance_b, bool final ) {
+      const uint64_t fields[8] = { N(eosio.token), id, N(alice), N(bob), nonce,
+                                   uint64_t(asset::from_string(balance_a).get_amount()),
+                                   uint64_t(asset::from_string(balance_b).get_amount()), uint64_t(final) };
+      char buf[32 + sizeof(fields)];
+      memcpy( buf, chain_id.data(), 32 );
+      memcpy( buf + 32, fields, sizeof(fields) );
+      const auto digest = fc::sha256::hash( buf, sizeof(buf) );
+      return mvo()
+         ("a", "alice")("b", "bob")("nonce", nonce)
+         ("balance_a", balance_a)("balance_b", balance_b)("final", final)
+         ("sig_a", get_private_key( N(alice), "active" ).sign( digest ))
+         ("sig_b", get_private_key( N(bob), "active" ).sign( digest ));
+   };
+   auto submit = [&]( const mvo& state ) {
+      return push_action( N(carol), N(chupdate), state );
+   };
+   auto update = [&]( uint64_t nonce, const string& balance_a, const string& balance_b, bool final ) {
+      return submit( signed_state( channel_id(), nonce, balance_a, balance_b, final ) );
+   };
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balances should add up to the deposits" ),
+      update( 1, "5.000000 HOT", "16.000000 HOT", false )
+   );
+   BOOST_REQUIRE_EQUAL( success(), update( 2, "8.000000 HOT", "12.000000 HOT", false ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "a newer state is already submitted" ),
+      update( 1, "12.000000 HOT", "8.000000 HOT", false )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "a newer state is already submitted" ),
+      update( 1, "12.000000 HOT", "8.000000 HOT", true )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "dispute window has not passed yet" ),
+      push_action( N(carol), N(chfinish), mvo()("a", "alice")("b", "bob") )
+   );
+
+   // only the net 6 HOT is a transfer, alice pays its fee
+   const auto old_final = signed_state( 1, 3, "4.000000 HOT", "16.000000 HOT", true );
+   BOOST_REQUIRE_EQUAL( success(), submit( old_final ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "93.994000 HOT")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "26.000000 HOT")
+   );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(sweepfees), mvo() ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.saving), "6,HOT"), mvo()
+      ("balance", "0.006000 HOT")
+   );
+
+   // states of the closed channel do not verify against a reopened one
+   BOOST_REQUIRE_EQUAL( success(), chopen( N(alice), N(bob), "10.000000 HOT" ) );
+   BOOST_REQUIRE_EQUAL( success(), chopen( N(bob), N(alice), "10.000000 HOT" ) );
+   BOOST_REQUIRE_EQUAL( 2, channel_id() );
+   produce_blocks(1);
+   BOOST_REQUIRE( success() != submit( old_final ) );
+   BOOST_REQUIRE( success() != submit( signed_state( 1, 4, "4.000000 HOT", "16.000000 HOT", false ) ) );
+   BOOST_REQUIRE_EQUAL( 2, channel_id() );
+
+   // nor does an older final state of this one
+   BOOST_REQUIRE_EQUAL( success(), update( 5, "12.000000 HOT", "8.000000 HOT", false ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "a newer state is already submitted" ),
+      update( 4, "2.000000 HOT", "18.000000 HOT", true )
+   );
+   BOOST_REQUIRE_EQUAL( success(), update( 6, "10.000000 HOT", "10.000000 HOT", true ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "6,HOT"), mvo()
+      ("balance", "93.994000 HOT")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "6,HOT"), mvo()
+      ("balance", "26.000000 HOT")
+   );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()